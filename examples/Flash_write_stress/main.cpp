@@ -0,0 +1,79 @@
+// Copyright 2026 p43lz3r
+// Flash write stress test: receives a busy bus while continuously writing
+// to LittleFS, and prints RX losses per second.
+//
+// Build once as-is and once with -DWAVESHARE_CAN_IRAM_HOT_PATH (plus
+// CONFIG_TWAI_ISR_IN_IRAM=y in the sdkconfig) and compare the numbers.
+// Feed the bus from a partner, e.g.: cangen can0 -g 1 -I 123 -L 8
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+volatile uint32_t rx_frames = 0;
+
+void OnFrame(const twai_message_t& msg) {
+  (void)msg;
+  rx_frames = rx_frames + 1;
+}
+
+uint8_t block[4096];
+unsigned long last_report = 0;
+uint32_t last_frames = 0;
+uint32_t bytes_written = 0;
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+#ifdef WAVESHARE_CAN_IRAM_HOT_PATH
+  Serial.println("\n=== WaveshareCAN Flash Write Stress (IRAM hot path) ===");
+#else
+  Serial.println("\n=== WaveshareCAN Flash Write Stress (hot path in flash) ===");
+#endif
+
+  if (!LittleFS.begin(true)) {
+    Serial.println("LittleFS mount failed - halting");
+    while (true) delay(1000);
+  }
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed - halting");
+    while (true) delay(1000);
+  }
+  can.EnableRxInterrupt(OnFrame);
+
+  for (size_t i = 0; i < sizeof(block); i++) block[i] = static_cast<uint8_t>(i);
+}
+
+void loop() {
+  // Drain our queue so drops only come from stalls, not from a full queue
+  while (can.ReceiveFromQueue(nullptr, nullptr, nullptr, nullptr) >= 0) {
+  }
+
+  // Flash writes disable the cache while each sector is programmed
+  File file = LittleFS.open("/stress.bin", "a");
+  if (file) {
+    bytes_written += file.write(block, sizeof(block));
+    if (file.size() > 256 * 1024) {
+      file.close();
+      LittleFS.remove("/stress.bin");
+    } else {
+      file.close();
+    }
+  }
+
+  unsigned long now = millis();
+  if (now - last_report >= 1000) {
+    last_report = now;
+    twai_status_info_t status;
+    can.GetStatus(&status);
+    uint32_t frames = rx_frames;
+    Serial.printf("rx %5lu/s | flash %6lu B/s | queue drops %lu | driver missed %lu "
+                  "overrun %lu\n",
+                  frames - last_frames, bytes_written, can.GetDroppedRxCount(),
+                  status.rx_missed_count, status.rx_overrun_count);
+    last_frames = frames;
+    bytes_written = 0;
+  }
+}
@@ -0,0 +1,31 @@
+// Copyright 2026 p43lz3r
+// Minimal polling sketch for footprint measurements. Uses only Begin(),
+// SendMessage() and ReceiveMessage() - no tasks, alerts or queues - so the
+// linker keeps none of those. Build it twice and compare the Flash/RAM
+// summary the toolchain prints:
+//   1. default profile
+//   2. build_flags = -DWAVESHARE_CAN_MINIMAL  (PlatformIO; the flag must
+//      reach the library sources, a #define in the sketch is not enough)
+
+#include <Arduino.h>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+void setup() {
+  Serial.begin(115200);
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed");
+  }
+}
+
+void loop() {
+  uint32_t id;
+  uint8_t data[8];
+  uint8_t length;
+  while (can.ReceiveMessage(&id, nullptr, data, &length) >= 0) {
+    // Echo every frame back with ID + 1
+    can.SendMessage(id + 1, data, length);
+  }
+  delay(1);
+}
@@ -0,0 +1,62 @@
+// Copyright 2026 p43lz3r
+// Reactive rules: the RX task answers frames itself, without loop().
+// - Vehicle speed (J1939 CCVS-style 0x18FEF100, bytes 1-2, 1/256 km/h)
+//   above 120 km/h sends a stop request and drops the relay pin.
+// - Emergency flag (0x080, byte 0 bit 0) drives the relay pin low.
+// loop() only prints per-rule counters and reaction latency.
+
+#include <Arduino.h>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+constexpr int kRelayPin = 6;
+
+int overspeed_rule = -1;
+int emergency_rule = -1;
+
+void PrintRule(const char* name, int index) {
+  CanRuleStats stats;
+  if (!can.GetRuleStats(index, &stats)) return;
+  Serial.printf("%-10s fired %6lu  tx failed %3lu  latency last %3lu us  "
+                "avg %3lu us  max %4lu us\n",
+                name, stats.fired, stats.tx_failed, stats.last_latency_us,
+                stats.fired ? static_cast<uint32_t>(stats.total_latency_us /
+                                                    stats.fired) : 0,
+                stats.max_latency_us);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  Serial.println("\n=== WaveshareCAN Reactive Rules ===");
+
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed - halting");
+    while (true) delay(1000);
+  }
+
+  // Reaction frame built once
+  CanTxHandle stop = WaveshareCan::MakeTxHandle(0x0C000000, true, 2);
+  uint8_t stop_payload[2] = {0x01, 0x00};
+  stop.SetPayload(stop_payload);
+
+  CanSignal speed = {8, 16, false, 1.0f / 256.0f, 0.0f};
+  overspeed_rule = can.AddRule(
+      CanRule::OnSignal(0x18FEF100, true, speed, kRuleGt, 120.0f)
+          .ThenSend(stop.message)
+          .ThenGpio(kRelayPin, 0));
+
+  emergency_rule = can.AddRule(
+      CanRule::OnBits(0x080, false, 0, 1, 1).ThenGpio(kRelayPin, 0));
+
+  digitalWrite(kRelayPin, HIGH);
+  can.EnableRxInterrupt();
+}
+
+void loop() {
+  PrintRule("overspeed", overspeed_rule);
+  PrintRule("emergency", emergency_rule);
+  Serial.println();
+  delay(2000);
+}
@@ -0,0 +1,86 @@
+// Copyright 2026 p43lz3r
+// RX latency benchmark: blocking RX task vs busy-poll RX task.
+// Sends self-received frames carrying their send timestamp and measures the
+// time until the RX callback sees them. The numbers include the frame time
+// on the wire (~230 us for 8 bytes at 500 kbps), which is the same in both
+// modes - compare the spread, not the absolute value.
+// Needs another node on the bus to ACK (e.g. Pi with candump).
+
+#include <Arduino.h>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+constexpr uint32_t kSamples = 2000;
+constexpr uint32_t kTestId = 0x7A0;
+
+volatile uint32_t latencies[kSamples];
+volatile uint32_t sample_count = 0;
+
+void OnFrame(const twai_message_t& msg) {
+  if (msg.identifier != kTestId || sample_count >= kSamples) return;
+  uint32_t sent;
+  memcpy(&sent, msg.data, sizeof(sent));
+  latencies[sample_count] = static_cast<uint32_t>(esp_timer_get_time()) - sent;
+  sample_count = sample_count + 1;
+}
+
+int CompareU32(const void* a, const void* b) {
+  uint32_t x = *static_cast<const uint32_t*>(a);
+  uint32_t y = *static_cast<const uint32_t*>(b);
+  return (x > y) - (x < y);
+}
+
+void RunOnce(const char* name) {
+  sample_count = 0;
+  CanFrame frame = {};
+  frame.id = kTestId;
+  frame.length = 8;
+  frame.self_rx = true;
+
+  for (uint32_t i = 0; i < kSamples; i++) {
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    memcpy(frame.data, &now, sizeof(now));
+    can.SendFrame(frame);
+    delay(2);  // One frame in flight at a time
+  }
+  delay(50);
+
+  uint32_t n = sample_count;
+  static uint32_t sorted[kSamples];
+  for (uint32_t i = 0; i < n; i++) sorted[i] = latencies[i];
+  qsort(sorted, n, sizeof(uint32_t), CompareU32);
+
+  if (n == 0) {
+    Serial.printf("%-10s no frames received - is a partner ACKing?\n", name);
+    return;
+  }
+  Serial.printf("%-10s n=%4lu  min %4lu  p50 %4lu  p99 %4lu  max %5lu us  "
+                "(jitter p99-p50 %lu us)\n",
+                name, n, sorted[0], sorted[n / 2], sorted[n * 99 / 100],
+                sorted[n - 1], sorted[n * 99 / 100] - sorted[n / 2]);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  Serial.println("\n=== WaveshareCAN RX Busy-Poll Benchmark ===");
+
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed - halting");
+    while (true) delay(1000);
+  }
+}
+
+void loop() {
+  can.EnableRxInterrupt(OnFrame);
+  RunOnce("blocking");
+  can.DisableRxInterrupt();
+
+  can.EnableRxBusyPoll(0, OnFrame);  // Core 0 - loop() runs on core 1
+  RunOnce("busy-poll");
+  can.DisableRxInterrupt();
+
+  Serial.println();
+  delay(3000);
+}
@@ -0,0 +1,60 @@
+// Copyright 2026 p43lz3r
+// Status cache benchmark: cost of Available() / GetStatus() with the cache
+// off (every call enters the driver's critical section) and on.
+
+#include <Arduino.h>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+constexpr uint32_t kCalls = 100000;
+
+void Measure(const char* name) {
+  twai_status_info_t status;
+  volatile int sink = 0;
+
+  uint32_t start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kCalls; i++) {
+    sink += can.Available();
+  }
+  uint32_t available_cycles = ESP.getCycleCount() - start;
+
+  start = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kCalls; i++) {
+    can.GetStatus(&status);
+  }
+  uint32_t status_cycles = ESP.getCycleCount() - start;
+
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  Serial.printf("%-12s Available() %5lu cycles (%4lu ns)   GetStatus() %5lu cycles (%4lu ns)\n",
+                name, available_cycles / kCalls,
+                available_cycles / kCalls * 1000 / mhz, status_cycles / kCalls,
+                status_cycles / kCalls * 1000 / mhz);
+  (void)sink;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  Serial.println("\n=== WaveshareCAN Status Cache Benchmark ===");
+
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed - halting");
+    while (true) delay(1000);
+  }
+  can.EnableAlertInterrupt();  // Refreshes the cache in the background
+}
+
+void loop() {
+  can.SetStatusCacheMaxAge(0);
+  Measure("cache off");
+
+  can.SetStatusCacheMaxAge(1000);  // Snapshot may be up to 1 ms old
+  Measure("cache 1 ms");
+
+  can.SetStatusCacheMaxAge(10000);
+  Measure("cache 10 ms");
+
+  Serial.println();
+  delay(3000);
+}
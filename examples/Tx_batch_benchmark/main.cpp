@@ -0,0 +1,79 @@
+// Copyright 2026 p43lz3r
+// TX batch benchmark: streams a block of frames with SendMessage() per frame
+// and with SendBatch(), then reports achieved bus utilization for both.
+// Needs at least one other node on the bus to ACK (e.g. Pi with candump).
+
+#include <Arduino.h>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+constexpr size_t kBlockFrames = 512;
+CanFrame block[kBlockFrames];
+
+// Wait until the driver TX queue has drained completely.
+void WaitTxDrained() {
+  twai_status_info_t status;
+  while (can.GetStatus(&status) && status.msgs_to_tx > 0) {
+    delayMicroseconds(50);
+  }
+}
+
+void Report(const char* name, size_t frames, uint32_t elapsed_us) {
+  uint64_t bits = 0;
+  for (size_t i = 0; i < frames; i++) {
+    bits += WaveshareCan::FrameBits(block[i].extended, block[i].length);
+  }
+  float capacity = static_cast<float>(can.GetBitrate()) * elapsed_us / 1e6f;
+  float load = capacity > 0 ? 100.0f * bits / capacity : 0;
+  Serial.printf("%-12s %4u frames  %7lu us  %6.1f us/frame  bus load %5.1f%%\n",
+                name, frames, elapsed_us,
+                frames ? static_cast<float>(elapsed_us) / frames : 0.0f, load);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  Serial.println("\n=== WaveshareCAN TX Batch Benchmark ===");
+
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed - halting");
+    while (true) delay(1000);
+  }
+
+  for (size_t i = 0; i < kBlockFrames; i++) {
+    block[i].id = 0x400;
+    block[i].extended = false;
+    block[i].rtr = false;
+    block[i].length = 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      block[i].data[b] = static_cast<uint8_t>(i + b);
+    }
+  }
+}
+
+void loop() {
+  // 1. One SendMessage() call per frame
+  uint32_t start = micros();
+  size_t sent = 0;
+  for (size_t i = 0; i < kBlockFrames; i++) {
+    if (!can.SendMessage(block[i].id, block[i].extended, block[i].data,
+                         block[i].length)) {
+      break;
+    }
+    sent++;
+  }
+  WaitTxDrained();
+  Report("SendMessage", sent, micros() - start);
+
+  delay(500);
+
+  // 2. Whole block through SendBatch()
+  start = micros();
+  sent = can.SendBatch(block, kBlockFrames, 5000);
+  WaitTxDrained();
+  Report("SendBatch", sent, micros() - start);
+
+  Serial.printf("TX failed so far: %lu\n\n", can.GetTxFailedCount());
+  delay(3000);
+}
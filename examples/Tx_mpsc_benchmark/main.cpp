@@ -0,0 +1,101 @@
+// Copyright 2026 p43lz3r
+// TX contention benchmark: several tasks call SendMessage() at the same
+// time, first straight into the driver, then through the lock-free TX queue.
+// Reports per-producer submit latency (avg/max) and failed submissions.
+// Needs at least one other node on the bus to ACK (e.g. Pi with candump).
+
+#include <Arduino.h>
+#include <atomic>
+#include "waveshare_can.h"
+
+WaveshareCan can(kBoard43b);
+
+constexpr int kProducers = 4;
+constexpr uint32_t kFramesPerProducer = 200;
+
+struct ProducerResult {
+  uint32_t sent;
+  uint32_t failed;
+  uint64_t total_us;
+  uint32_t max_us;
+};
+
+ProducerResult results[kProducers];
+std::atomic<int> producers_done(0);
+volatile bool go = false;
+
+void ProducerTask(void* arg) {
+  int index = reinterpret_cast<intptr_t>(arg);
+  ProducerResult& r = results[index];
+  r = {};
+  uint8_t data[8] = {static_cast<uint8_t>(index)};
+
+  while (!go) vTaskDelay(1);
+
+  for (uint32_t i = 0; i < kFramesPerProducer; i++) {
+    data[1] = static_cast<uint8_t>(i);
+    data[2] = static_cast<uint8_t>(i >> 8);
+    uint32_t start = micros();
+    bool ok = can.SendMessage(0x500 + index, data, 8);
+    uint32_t elapsed = micros() - start;
+    if (ok) {
+      r.sent++;
+    } else {
+      r.failed++;
+    }
+    r.total_us += elapsed;
+    if (elapsed > r.max_us) r.max_us = elapsed;
+    if ((i & 15) == 0) vTaskDelay(1);  // Let the other producers interleave
+  }
+
+  producers_done++;
+  vTaskDelete(NULL);
+}
+
+void RunRound(const char* name) {
+  producers_done = 0;
+  go = false;
+  for (int i = 0; i < kProducers; i++) {
+    xTaskCreate(ProducerTask, "producer", 3072,
+                reinterpret_cast<void*>(static_cast<intptr_t>(i)), 3, nullptr);
+  }
+  delay(50);
+  go = true;
+  while (producers_done < kProducers) delay(10);
+
+  Serial.printf("-- %s --\n", name);
+  for (int i = 0; i < kProducers; i++) {
+    const ProducerResult& r = results[i];
+    uint32_t calls = r.sent + r.failed;
+    Serial.printf("producer %d: sent %4lu  failed %3lu  avg %6.1f us  max %6lu us\n",
+                  i, r.sent, r.failed,
+                  calls ? static_cast<float>(r.total_us) / calls : 0.0f, r.max_us);
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  Serial.println("\n=== WaveshareCAN TX Contention Benchmark ===");
+
+  if (!can.Begin(kCan500Kbps)) {
+    Serial.println("CAN init failed - halting");
+    while (true) delay(1000);
+  }
+}
+
+void loop() {
+  // 1. Every producer blocks in the driver's TX path
+  can.DisableTxQueue();
+  RunRound("direct (driver locking)");
+  delay(1000);
+
+  // 2. Producers only claim a slot in the MPSC queue; the TX task sends
+  can.EnableTxQueue(kProducers * kFramesPerProducer);
+  RunRound("lock-free TX queue");
+  while (can.QueuedTxMessages() > 0) delay(10);
+
+  WaveshareCan::TaskStats stats = can.GetTaskStats();
+  Serial.printf("TX queue high water: %lu\n\n", stats.tx_queue_high_water);
+  delay(3000);
+}
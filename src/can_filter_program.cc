@@ -0,0 +1,423 @@
+// Copyright 2026 p43lz3r
+#include "can_filter_program.h"
+
+#include <string.h>
+#include <strings.h>
+#include "waveshare_can_attrs.h"
+
+namespace {
+
+// Stack effect of each opcode
+struct OpShape {
+  uint8_t pops;
+  uint8_t pushes;
+};
+
+constexpr OpShape kOpShapes[kFilterOpCount] = {
+    {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1}, {0, 1},  // Loads
+    {1, 1}, {1, 1},                                  // ! ~
+    {2, 1}, {2, 1}, {2, 1}, {2, 1}, {2, 1},          // || && | ^ &
+    {2, 1}, {2, 1}, {2, 1}, {2, 1}, {2, 1}, {2, 1},  // Comparisons
+    {2, 1}, {2, 1},                                  // << >>
+    {3, 1},                                          // in lo..hi
+};
+
+// Recursive-descent compiler, one function per precedence level.
+// Emits postfix code directly; Validate() runs on the result afterwards.
+class FilterCompiler {
+ public:
+  FilterCompiler(const char* source, CanFilterInsn* code)
+      : source_(source), pos_(source), code_(code), count_(0), nesting_(0),
+        error_(nullptr), error_pos_(0) {}
+
+  bool Run() {
+    ParseOr();
+    SkipSpace();
+    if (!error_ && *pos_ != '\0') Fail("unexpected text");
+    return error_ == nullptr;
+  }
+
+  size_t Count() const { return count_; }
+  const char* Error() const { return error_; }
+  size_t ErrorPos() const { return error_pos_; }
+
+ private:
+  void Fail(const char* message) {
+    if (error_) return;
+    error_ = message;
+    error_pos_ = pos_ - source_;
+  }
+
+  void Emit(CanFilterOp op, uint32_t imm = 0, uint8_t arg = 0) {
+    if (error_) return;
+    if (count_ >= CanFilterProgram::kMaxInsns) {
+      Fail("expression too long");
+      return;
+    }
+    code_[count_++] = CanFilterInsn{static_cast<uint8_t>(op), arg, imm};
+  }
+
+  void SkipSpace() {
+    while (*pos_ == ' ' || *pos_ == '\t') pos_++;
+  }
+
+  // Consume `token` if it comes next. `exclude` rejects a longer operator
+  // with the same prefix ("<" vs "<<", "&" vs "&&").
+  bool Accept(const char* token, char exclude = '\0') {
+    SkipSpace();
+    size_t len = strlen(token);
+    if (strncmp(pos_, token, len) != 0) return false;
+    if (exclude != '\0' && pos_[len] == exclude) return false;
+    pos_ += len;
+    return true;
+  }
+
+  bool AcceptWord(const char* word) {
+    SkipSpace();
+    size_t len = strlen(word);
+    if (strncasecmp(pos_, word, len) != 0 || IsWordChar(pos_[len])) {
+      return false;
+    }
+    pos_ += len;
+    return true;
+  }
+
+  static bool IsWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+  }
+
+  bool ParseNumber(uint32_t* value) {
+    SkipSpace();
+    int base = 10;
+    const char* p = pos_;
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+      base = 16;
+      p += 2;
+    }
+    uint64_t result = 0;
+    const char* digits = p;
+    for (;; p++) {
+      int digit;
+      if (*p >= '0' && *p <= '9') {
+        digit = *p - '0';
+      } else if (base == 16 && *p >= 'a' && *p <= 'f') {
+        digit = *p - 'a' + 10;
+      } else if (base == 16 && *p >= 'A' && *p <= 'F') {
+        digit = *p - 'A' + 10;
+      } else {
+        break;
+      }
+      result = result * base + digit;
+      if (result > 0xFFFFFFFF) {
+        Fail("number out of range");
+        return false;
+      }
+    }
+    if (p == digits || IsWordChar(*p)) {
+      Fail("expected number");
+      return false;
+    }
+    pos_ = p;
+    *value = static_cast<uint32_t>(result);
+    return true;
+  }
+
+  void ParseOr() {
+    ParseAnd();
+    while (!error_ && (Accept("||") || AcceptWord("or"))) {
+      ParseAnd();
+      Emit(kFilterOr);
+    }
+  }
+
+  void ParseAnd() {
+    ParseBitOr();
+    while (!error_ && (Accept("&&") || AcceptWord("and"))) {
+      ParseBitOr();
+      Emit(kFilterAnd);
+    }
+  }
+
+  void ParseBitOr() {
+    ParseBitXor();
+    while (!error_ && Accept("|", '|')) {
+      ParseBitXor();
+      Emit(kFilterBitOr);
+    }
+  }
+
+  void ParseBitXor() {
+    ParseBitAnd();
+    while (!error_ && Accept("^")) {
+      ParseBitAnd();
+      Emit(kFilterBitXor);
+    }
+  }
+
+  void ParseBitAnd() {
+    ParseEquality();
+    while (!error_ && Accept("&", '&')) {
+      ParseEquality();
+      Emit(kFilterBitAnd);
+    }
+  }
+
+  void ParseEquality() {
+    ParseRelational();
+    while (!error_) {
+      if (Accept("==")) {
+        ParseRelational();
+        Emit(kFilterEq);
+      } else if (Accept("!=")) {
+        ParseRelational();
+        Emit(kFilterNe);
+      } else {
+        break;
+      }
+    }
+  }
+
+  void ParseRelational() {
+    ParseShift();
+    while (!error_) {
+      CanFilterOp op;
+      if (Accept("<=")) {
+        op = kFilterLe;
+      } else if (Accept(">=")) {
+        op = kFilterGe;
+      } else if (Accept("<", '<')) {
+        op = kFilterLt;
+      } else if (Accept(">", '>')) {
+        op = kFilterGt;
+      } else if (AcceptWord("in")) {
+        uint32_t lo, hi;
+        if (!ParseNumber(&lo)) return;
+        if (!Accept("..")) {
+          Fail("expected '..'");
+          return;
+        }
+        if (!ParseNumber(&hi)) return;
+        Emit(kFilterConst, lo);
+        Emit(kFilterConst, hi);
+        Emit(kFilterInRange);
+        continue;
+      } else {
+        break;
+      }
+      ParseShift();
+      Emit(op);
+    }
+  }
+
+  void ParseShift() {
+    ParseUnary();
+    while (!error_) {
+      if (Accept("<<")) {
+        ParseUnary();
+        Emit(kFilterShl);
+      } else if (Accept(">>")) {
+        ParseUnary();
+        Emit(kFilterShr);
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Parentheses and unary operators recurse; cap the depth so a hostile
+  // expression cannot exhaust the caller's stack
+  bool Nest() {
+    if (++nesting_ > CanFilterProgram::kMaxStack) {
+      Fail("expression too deep");
+      return false;
+    }
+    return true;
+  }
+
+  void ParseUnary() {
+    if (error_ || !Nest()) return;
+    if (Accept("!", '=') || AcceptWord("not")) {
+      ParseUnary();
+      Emit(kFilterNot);
+    } else if (Accept("~")) {
+      ParseUnary();
+      Emit(kFilterBitNot);
+    } else {
+      ParsePrimary();
+    }
+    nesting_--;
+  }
+
+  void ParsePrimary() {
+    if (error_) return;
+    uint32_t value;
+    if (Accept("(")) {
+      ParseOr();
+      if (!error_ && !Accept(")")) Fail("expected ')'");
+    } else if (AcceptWord("id")) {
+      Emit(kFilterId);
+    } else if (AcceptWord("dlc")) {
+      Emit(kFilterDlc);
+    } else if (AcceptWord("ext")) {
+      Emit(kFilterExt);
+    } else if (AcceptWord("rtr")) {
+      Emit(kFilterRtr);
+    } else if (AcceptWord("data")) {
+      if (!Accept("[")) {
+        Fail("expected '['");
+        return;
+      }
+      if (!ParseNumber(&value)) return;
+      if (value >= TWAI_FRAME_MAX_DLC) {
+        Fail("data index must be 0..7");
+        return;
+      }
+      if (!Accept("]")) {
+        Fail("expected ']'");
+        return;
+      }
+      Emit(kFilterData, 0, static_cast<uint8_t>(value));
+    } else {
+      SkipSpace();
+      if (*pos_ >= '0' && *pos_ <= '9') {
+        if (ParseNumber(&value)) Emit(kFilterConst, value);
+      } else {
+        Fail("expected operand");
+      }
+    }
+  }
+
+  const char* source_;
+  const char* pos_;
+  CanFilterInsn* code_;
+  size_t count_;
+  size_t nesting_;
+  const char* error_;
+  size_t error_pos_;
+};
+
+}  // namespace
+
+CanFilterProgram::CanFilterProgram()
+    : insns_(), count_(0), error_(nullptr), error_pos_(0) {}
+
+bool CanFilterProgram::Compile(const char* expression) {
+  count_ = 0;
+  error_ = nullptr;
+  error_pos_ = 0;
+  if (expression == nullptr) {
+    error_ = "no expression";
+    return false;
+  }
+
+  FilterCompiler compiler(expression, insns_);
+  if (!compiler.Run()) {
+    error_ = compiler.Error();
+    error_pos_ = compiler.ErrorPos();
+    return false;
+  }
+  if (!Validate(insns_, compiler.Count(), &error_)) return false;
+  count_ = compiler.Count();
+  return true;
+}
+
+bool CanFilterProgram::Load(const CanFilterInsn* code, size_t count) {
+  count_ = 0;
+  error_ = nullptr;
+  error_pos_ = 0;
+  if (!Validate(code, count, &error_)) return false;
+  memcpy(insns_, code, count * sizeof(CanFilterInsn));
+  count_ = count;
+  return true;
+}
+
+bool CanFilterProgram::Validate(const CanFilterInsn* code, size_t count,
+                                const char** error) {
+  const char* problem = nullptr;
+  size_t depth = 0;
+  if (code == nullptr || count == 0) {
+    problem = "empty program";
+  } else if (count > kMaxInsns) {
+    problem = "program too long";
+  }
+
+  for (size_t i = 0; problem == nullptr && i < count; i++) {
+    const CanFilterInsn& insn = code[i];
+    if (insn.op >= kFilterOpCount) {
+      problem = "unknown opcode";
+      break;
+    }
+    if (insn.op == kFilterData && insn.arg >= TWAI_FRAME_MAX_DLC) {
+      problem = "data index out of range";
+      break;
+    }
+    const OpShape& shape = kOpShapes[insn.op];
+    if (depth < shape.pops) {
+      problem = "stack underflow";
+      break;
+    }
+    depth = depth - shape.pops + shape.pushes;
+    if (depth > kMaxStack) problem = "expression too deep";
+  }
+
+  if (problem == nullptr && depth != 1) problem = "program must leave one value";
+  if (error) *error = problem;
+  return problem == nullptr;
+}
+
+// Straight-line interpreter: one pass over at most kMaxInsns instructions.
+// Operand counts were checked by Validate(), so no bounds checks here.
+bool WAVESHARE_CAN_HOT CanFilterProgram::Matches(const twai_message_t& msg) const {
+  if (count_ == 0) return true;
+
+  uint32_t stack[kMaxStack];
+  size_t sp = 0;
+  for (size_t i = 0; i < count_; i++) {
+    const CanFilterInsn& insn = insns_[i];
+    uint32_t b;
+    switch (insn.op) {
+      case kFilterConst: stack[sp++] = insn.imm; continue;
+      case kFilterId: stack[sp++] = msg.identifier; continue;
+      case kFilterDlc: stack[sp++] = msg.data_length_code; continue;
+      case kFilterExt: stack[sp++] = msg.extd; continue;
+      case kFilterRtr: stack[sp++] = msg.rtr; continue;
+      case kFilterData:
+        stack[sp++] = (!msg.rtr && insn.arg < msg.data_length_code)
+                          ? msg.data[insn.arg] : 0;
+        continue;
+      case kFilterNot: stack[sp - 1] = !stack[sp - 1]; continue;
+      case kFilterBitNot: stack[sp - 1] = ~stack[sp - 1]; continue;
+      case kFilterInRange: {
+        uint32_t hi = stack[--sp];
+        uint32_t lo = stack[--sp];
+        uint32_t x = stack[sp - 1];
+        stack[sp - 1] = x >= lo && x <= hi;
+        continue;
+      }
+      default:
+        break;
+    }
+
+    // Binary operators
+    b = stack[--sp];
+    uint32_t& a = stack[sp - 1];
+    switch (insn.op) {
+      case kFilterOr: a = a || b; break;
+      case kFilterAnd: a = a && b; break;
+      case kFilterBitOr: a |= b; break;
+      case kFilterBitXor: a ^= b; break;
+      case kFilterBitAnd: a &= b; break;
+      case kFilterEq: a = a == b; break;
+      case kFilterNe: a = a != b; break;
+      case kFilterLt: a = a < b; break;
+      case kFilterLe: a = a <= b; break;
+      case kFilterGt: a = a > b; break;
+      case kFilterGe: a = a >= b; break;
+      case kFilterShl: a <<= (b & 31); break;
+      case kFilterShr: a >>= (b & 31); break;
+      default: break;
+    }
+  }
+  return stack[0] != 0;
+}
@@ -0,0 +1,95 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_CAN_FILTER_PROGRAM_H_
+#define PROJECT_CAN_FILTER_PROGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+// Frame filter bytecode.
+//
+// A filter is a C-like expression over one frame, compiled to a small
+// stack program:
+//
+//   id == 0x18FEF100 && ext && (data[2] & 0x10)
+//   DLC == 8 and data[0] in 0x10..0x1F
+//
+// Operands: id, dlc, ext, rtr, data[0..7] (0 past the DLC), decimal or hex
+// literals. Operators, loosest first: ||  &&  |  ^  &  == !=  < <= > >=
+// in lo..hi  << >>  ! ~ (unary), with parentheses. and/or/not may be
+// written for && || ! ; keywords are case-insensitive.
+// A frame matches if the result is non-zero.
+//
+// Programs have no jumps, so execution time is bounded by their length.
+// Validate() proves before the first run that every instruction is known,
+// operands are in range and the stack never under- or overflows.
+
+enum CanFilterOp : uint8_t {
+  kFilterConst,    // push imm
+  kFilterId,       // push identifier
+  kFilterDlc,      // push data_length_code
+  kFilterExt,      // push extd
+  kFilterRtr,      // push rtr
+  kFilterData,     // push data[arg]
+  kFilterNot,      // a -> !a
+  kFilterBitNot,   // a -> ~a
+  kFilterOr,       // a b -> a || b
+  kFilterAnd,      // a b -> a && b
+  kFilterBitOr,    // a b -> a | b
+  kFilterBitXor,   // a b -> a ^ b
+  kFilterBitAnd,   // a b -> a & b
+  kFilterEq,       // a b -> a == b
+  kFilterNe,
+  kFilterLt,
+  kFilterLe,
+  kFilterGt,
+  kFilterGe,
+  kFilterShl,      // a b -> a << (b & 31)
+  kFilterShr,      // a b -> a >> (b & 31)
+  kFilterInRange,  // x lo hi -> lo <= x && x <= hi
+  kFilterOpCount
+};
+
+struct CanFilterInsn {
+  uint8_t op;    // CanFilterOp
+  uint8_t arg;   // Byte index for kFilterData
+  uint32_t imm;  // Constant for kFilterConst
+};
+
+class CanFilterProgram {
+ public:
+  static constexpr size_t kMaxInsns = 64;
+  static constexpr size_t kMaxStack = 16;
+
+  CanFilterProgram();
+
+  // Compile and validate an expression. On failure the program is left
+  // empty and Error()/ErrorPos() describe the problem.
+  bool Compile(const char* expression);
+
+  // Install prebuilt bytecode (e.g. stored in flash); validated first
+  bool Load(const CanFilterInsn* code, size_t count);
+
+  // Run the program. An empty program matches every frame.
+  bool Matches(const twai_message_t& msg) const;
+
+  void Clear() { count_ = 0; }
+  bool Empty() const { return count_ == 0; }
+  size_t Size() const { return count_; }
+  const CanFilterInsn* Code() const { return insns_; }
+
+  const char* Error() const { return error_; }
+  size_t ErrorPos() const { return error_pos_; }  // Offset in the expression
+
+  // Bounded-execution check for arbitrary bytecode
+  static bool Validate(const CanFilterInsn* code, size_t count,
+                       const char** error = nullptr);
+
+ private:
+  CanFilterInsn insns_[kMaxInsns];
+  size_t count_;
+  const char* error_;
+  size_t error_pos_;
+};
+
+#endif  // PROJECT_CAN_FILTER_PROGRAM_H_
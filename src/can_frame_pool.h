@@ -0,0 +1,118 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_CAN_FRAME_POOL_H_
+#define PROJECT_CAN_FRAME_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "driver/twai.h"
+#include "waveshare_can_policies.h"
+
+// Pool slot: one received frame plus the number of live references.
+// refs == 0 means the slot is free.
+struct CanPooledFrame {
+  std::atomic<uint32_t> refs;
+  twai_message_t message;
+};
+
+// Counted reference to a pooled frame. Copies share the frame; the slot
+// goes back to the pool when the last reference is destroyed or Reset().
+// The frame is read-only - every holder sees the same bytes.
+class CanFrameRef {
+ public:
+  CanFrameRef() : slot_(nullptr) {}
+  CanFrameRef(const CanFrameRef& other) : slot_(other.slot_) {
+    if (slot_) slot_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  CanFrameRef(CanFrameRef&& other) : slot_(other.slot_) { other.slot_ = nullptr; }
+  ~CanFrameRef() { Reset(); }
+
+  CanFrameRef& operator=(const CanFrameRef& other) {
+    if (this != &other) {
+      if (other.slot_) other.slot_->refs.fetch_add(1, std::memory_order_relaxed);
+      Reset();
+      slot_ = other.slot_;
+    }
+    return *this;
+  }
+
+  CanFrameRef& operator=(CanFrameRef&& other) {
+    if (this != &other) {
+      Reset();
+      slot_ = other.slot_;
+      other.slot_ = nullptr;
+    }
+    return *this;
+  }
+
+  // Take over one reference already counted in slot->refs
+  __attribute__((always_inline)) static CanFrameRef Adopt(
+      CanPooledFrame* slot) {
+    CanFrameRef ref;
+    ref.slot_ = slot;
+    return ref;
+  }
+
+  __attribute__((always_inline)) void Reset() {
+    if (slot_) slot_->refs.fetch_sub(1, std::memory_order_acq_rel);
+    slot_ = nullptr;
+  }
+
+  explicit operator bool() const { return slot_ != nullptr; }
+  const twai_message_t& operator*() const { return slot_->message; }
+  const twai_message_t* operator->() const { return &slot_->message; }
+
+ private:
+  CanPooledFrame* slot_;
+};
+
+// Fixed-size frame pool. A single task allocates (Acquire); references
+// are dropped from any task. Allocation resumes scanning after the last
+// slot handed out, so with consumers keeping up it finds a free slot on
+// the first probe. Acquire() runs in RX dispatch and is force-inlined
+// like the ring buffer's Push/Pop, so it stays in IRAM with its caller.
+template <size_t kSlots>
+class CanFramePool {
+ public:
+  CanFramePool() : slots_(), cursor_(0), exhausted_count_(0) {}
+
+  CanFramePool(const CanFramePool&) = delete;
+  CanFramePool& operator=(const CanFramePool&) = delete;
+
+  // Copy `message` into a free slot holding `refs` references.
+  // Returns nullptr (and counts it) if every slot is still referenced.
+  __attribute__((always_inline)) CanPooledFrame* Acquire(const twai_message_t& message, uint32_t refs) {
+    for (size_t i = 0; i < kSlots; i++) {
+      size_t index = (cursor_ + i) % kSlots;
+      CanPooledFrame& slot = slots_[index];
+      if (slot.refs.load(std::memory_order_acquire) == 0) {
+        slot.message = message;
+        slot.refs.store(refs, std::memory_order_release);
+        cursor_ = (index + 1) % kSlots;
+        return &slot;
+      }
+    }
+    CanStats::Add(exhausted_count_);
+    return nullptr;
+  }
+
+  // Slots currently referenced (scans the pool)
+  uint32_t InUse() const {
+    uint32_t used = 0;
+    for (size_t i = 0; i < kSlots; i++) {
+      if (slots_[i].refs.load(std::memory_order_relaxed) != 0) used++;
+    }
+    return used;
+  }
+
+  uint32_t GetExhaustedCount() const { return exhausted_count_; }
+  void ResetExhaustedCount() { exhausted_count_ = 0; }
+  static constexpr size_t Slots() { return kSlots; }
+
+ private:
+  CanPooledFrame slots_[kSlots];
+  size_t cursor_;  // Allocator only
+  volatile uint32_t exhausted_count_;
+};
+
+#endif  // PROJECT_CAN_FRAME_POOL_H_
@@ -0,0 +1,338 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_CAN_ID_SET_H_
+#define PROJECT_CAN_ID_SET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+// Compile-time set of subscribed CAN IDs.
+//
+//   constexpr CanIdSet kIds({0x100, 0x1A0, 0x2F1, 0x7DF});  // C++17 (CTAD)
+//   constexpr CanIdSet<4> kIds({0x100, 0x1A0, 0x2F1, 0x7DF});  // pre-C++17
+//   can.UseIdSet(kIds);                       // hardware filter + RX check
+//   int slot = kIds.IndexOf(msg.identifier);  // dispatch table index
+//
+// Everything is computed by the compiler: the tightest acceptance
+// code/mask covering all IDs (single filter, or dual filter for standard
+// IDs when two groups pass fewer foreign IDs) and a collision-free
+// hash-and-displace table of at least 4 * N slots. A lookup is two
+// multiplies, one displacement load and one compare.
+//
+// Declare sets constexpr: a duplicate ID, an ID out of range (11 or 29
+// bits), or a set without a perfect hash then fails the build with a call
+// to one of the IdSetError*() functions below. A non-constexpr set that
+// fails reports Valid() == false and matches nothing.
+//
+// CanIdSet needs C++14 (loops in constexpr functions); with C++11 only the
+// CanIdLookup view below is available.
+
+// Type-erased view of a CanIdSet for the RX path. Points into the set's
+// tables, so the set must outlive it (declare sets constexpr at namespace
+// scope).
+struct CanIdLookup {
+  const uint32_t* keys;           // kEmptyKey or ID per slot
+  const uint8_t* indices;         // Position of the ID in the original list
+  const uint16_t* displacements;  // Per bucket, XORed into the slot
+  uint32_t bucket_multiplier;
+  uint32_t slot_multiplier;
+  uint8_t bucket_shift;           // 32 - log2(bucket count)
+  uint8_t slot_shift;             // 32 - log2(table size)
+  bool extended;
+
+  // Marks free slots. Never a valid ID (at most 29 bits), but a caller
+  // can still pass it in, so Find() rejects it explicitly.
+  static constexpr uint32_t kEmptyKey = 0xFFFFFFFF;
+
+  // Index of `id` in the original list, or -1. Single-expression constexpr
+  // so it also builds as C++11.
+  constexpr int Find(uint32_t id, bool is_extended) const {
+    return (keys != nullptr && is_extended == extended && id != kEmptyKey &&
+            keys[Slot(id)] == id)
+               ? indices[Slot(id)]
+               : -1;
+  }
+
+  constexpr uint32_t Slot(uint32_t id) const {
+    return ((id * slot_multiplier) >> slot_shift) ^
+           displacements[(id * bucket_multiplier) >> bucket_shift];
+  }
+};
+
+#if __cplusplus >= 201402L
+namespace can_id_set_internal {
+
+// Smallest bits with 2^bits >= n (at least 1)
+constexpr size_t CeilLog2(size_t n) {
+  size_t bits = 1;
+  while ((size_t(1) << bits) < n) bits++;
+  return bits;
+}
+
+// Not constexpr: reaching one during constant evaluation is a build error
+// whose message names the problem
+inline void IdSetErrorDuplicateId() {}
+inline void IdSetErrorIdOutOfRange() {}
+inline void IdSetErrorNoPerfectHash() {}
+
+}  // namespace can_id_set_internal
+
+template <size_t N>
+class CanIdSet {
+  static_assert(N > 0 && N <= 255, "CanIdSet holds 1..255 IDs");
+
+ public:
+  static constexpr size_t kTableBits = can_id_set_internal::CeilLog2(4 * N);
+  static constexpr size_t kTableSize = size_t(1) << kTableBits;
+  static constexpr size_t kBucketBits = can_id_set_internal::CeilLog2(N);
+  static constexpr size_t kBuckets = size_t(1) << kBucketBits;
+
+  constexpr CanIdSet(const uint32_t (&ids)[N], bool extended = false)
+      : ids_(), keys_(), indices_(), displacements_(), bucket_multiplier_(0),
+        slot_multiplier_(0), extended_(extended), valid_(false) {
+    const uint32_t max_id = extended ? 0x1FFFFFFF : 0x7FF;
+    for (size_t i = 0; i < N; i++) {
+      ids_[i] = ids[i];
+      if (ids[i] > max_id) {
+        can_id_set_internal::IdSetErrorIdOutOfRange();
+        return;
+      }
+      for (size_t j = 0; j < i; j++) {
+        if (ids[i] == ids[j]) {
+          can_id_set_internal::IdSetErrorDuplicateId();
+          return;
+        }
+      }
+    }
+    Build();
+  }
+
+  // False if the set has duplicate or out-of-range IDs or no perfect hash
+  // was found (only possible for sets that are not constexpr)
+  constexpr bool Valid() const { return valid_; }
+
+  // Position of `id` in the original list, or -1 if not in the set
+  constexpr int IndexOf(uint32_t id) const { return View().Find(id, extended_); }
+  constexpr bool Contains(uint32_t id) const { return IndexOf(id) >= 0; }
+
+  constexpr size_t Size() const { return N; }
+  constexpr uint32_t Id(size_t index) const { return ids_[index]; }
+  constexpr bool Extended() const { return extended_; }
+
+  // Tightest acceptance filter that passes every ID in the set. Mask bits
+  // are 1 = don't care, as in twai_filter_config_t; RTR and data bits are
+  // ignored. Standard-ID sets also consider dual filter mode (two 11-bit
+  // filters) and use whichever layout lets fewer foreign IDs through.
+  constexpr twai_filter_config_t FilterConfig() const {
+    twai_filter_config_t config = {};
+    Cover all = CoverOf(kAllIds, 0);
+    if (extended_) {
+      config.acceptance_code = all.code << 3;
+      config.acceptance_mask = (all.differing << 3) | 0x7;
+      config.single_filter = true;
+      return config;
+    }
+
+    Split best = BestSplit();
+    if (best.passes >= PassCount(all)) {
+      config.acceptance_code = all.code << 21;
+      config.acceptance_mask = (all.differing << 21) | 0x1FFFFF;
+      config.single_filter = true;
+      return config;
+    }
+
+    // Dual filter: filter 1 = ID bits 31..21 (+ RTR, data nibble ignored),
+    // filter 2 = ID bits 15..5 (+ RTR ignored)
+    Cover first = CoverOf(best.mode, best.arg);
+    Cover second = CoverOf(best.mode, best.arg, true);
+    config.acceptance_code = (first.code << 21) | (second.code << 5);
+    config.acceptance_mask = (first.differing << 21) | 0x1F0000 |
+                             (second.differing << 5) | 0x1F;
+    config.single_filter = false;
+    return config;
+  }
+
+  // Upper bound on how many distinct IDs the FilterConfig() hardware
+  // filter accepts (N = exact match)
+  constexpr uint32_t HardwarePassCount() const {
+    Cover all = CoverOf(kAllIds, 0);
+    if (extended_) return PassCount(all);
+    Split best = BestSplit();
+    return best.passes < PassCount(all) ? best.passes : PassCount(all);
+  }
+
+  constexpr CanIdLookup View() const {
+    return CanIdLookup{valid_ ? keys_ : nullptr, indices_, displacements_,
+                       bucket_multiplier_, slot_multiplier_,
+                       static_cast<uint8_t>(32 - kBucketBits),
+                       static_cast<uint8_t>(32 - kTableBits), extended_};
+  }
+
+ private:
+  // Group selectors for splitting the set between the two dual filters
+  static constexpr int kAllIds = 0;   // Every ID (no split)
+  static constexpr int kSubset = 1;   // Bit i of arg set = ID i in group 2
+  static constexpr int kIdBit = 2;    // ID bit `arg` set = group 2
+
+  struct Cover {
+    uint32_t code;       // Bits every ID in the group shares
+    uint32_t differing;  // Bits the IDs disagree on
+    bool empty;
+  };
+
+  struct Split {
+    int mode;
+    uint32_t arg;
+    uint32_t passes;
+  };
+
+  constexpr bool InSecond(int mode, uint32_t arg, size_t i) const {
+    if (mode == kSubset) return (arg >> i) & 1;
+    if (mode == kIdBit) return (ids_[i] >> arg) & 1;
+    return false;
+  }
+
+  constexpr Cover CoverOf(int mode, uint32_t arg, bool second = false) const {
+    uint32_t all_ones = 0xFFFFFFFF;
+    uint32_t any_one = 0;
+    bool empty = true;
+    for (size_t i = 0; i < N; i++) {
+      if (InSecond(mode, arg, i) != second) continue;
+      all_ones &= ids_[i];
+      any_one |= ids_[i];
+      empty = false;
+    }
+    return Cover{all_ones, all_ones ^ any_one, empty};
+  }
+
+  static constexpr uint32_t PassCount(const Cover& cover) {
+    if (cover.empty) return 0;
+    uint32_t bits = 0;
+    for (uint32_t d = cover.differing; d != 0; d &= d - 1) bits++;
+    return 1u << bits;
+  }
+
+  constexpr uint32_t SplitPasses(int mode, uint32_t arg) const {
+    Cover first = CoverOf(mode, arg);
+    Cover second = CoverOf(mode, arg, true);
+    if (first.empty || second.empty) return 0xFFFFFFFF;
+    return PassCount(first) + PassCount(second);
+  }
+
+  // Small sets: try every partition. Larger sets: split on one ID bit.
+  constexpr Split BestSplit() const {
+    Split best = {kAllIds, 0, 0xFFFFFFFF};
+    if (N < 2) return best;
+    if (N <= 12) {
+      for (uint32_t subset = 1; subset < (1u << (N - 1)); subset++) {
+        uint32_t passes = SplitPasses(kSubset, subset);
+        if (passes < best.passes) best = Split{kSubset, subset, passes};
+      }
+    } else {
+      for (uint32_t bit = 0; bit < 11; bit++) {
+        uint32_t passes = SplitPasses(kIdBit, bit);
+        if (passes < best.passes) best = Split{kIdBit, bit, passes};
+      }
+    }
+    return best;
+  }
+
+  // Hash and displace: a first multiplicative hash picks a bucket, a second
+  // one a base slot; each bucket stores the XOR displacement that moves all
+  // of its IDs to free slots. Buckets are placed largest first. Multiplier
+  // pairs come from a 64-bit LCG, so every attempt is an unrelated hash
+  // pair; with 4 * N slots almost every set succeeds on the first one.
+  constexpr void Build() {
+    constexpr uint32_t kMaxAttempts = 64;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (uint32_t attempt = 0; attempt < kMaxAttempts; attempt++) {
+      bucket_multiplier_ = NextMultiplier(&state);
+      slot_multiplier_ = NextMultiplier(&state);
+      if (TryPlace()) {
+        valid_ = true;
+        return;
+      }
+    }
+    can_id_set_internal::IdSetErrorNoPerfectHash();
+  }
+
+  static constexpr uint32_t NextMultiplier(uint64_t* state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<uint32_t>(*state >> 32) | 1;
+  }
+
+  constexpr uint32_t BucketOf(uint32_t id) const {
+    return (id * bucket_multiplier_) >> (32 - kBucketBits);
+  }
+
+  constexpr uint32_t BaseSlotOf(uint32_t id) const {
+    return (id * slot_multiplier_) >> (32 - kTableBits);
+  }
+
+  constexpr bool TryPlace() {
+    for (size_t s = 0; s < kTableSize; s++) {
+      keys_[s] = CanIdLookup::kEmptyKey;
+      indices_[s] = 0;
+    }
+    uint16_t sizes[kBuckets] = {};
+    size_t largest = 0;
+    for (size_t i = 0; i < N; i++) {
+      uint16_t size = ++sizes[BucketOf(ids_[i])];
+      if (size > largest) largest = size;
+    }
+
+    for (size_t size = largest; size > 0; size--) {
+      for (size_t b = 0; b < kBuckets; b++) {
+        if (sizes[b] == size && !PlaceBucket(static_cast<uint32_t>(b))) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Find a displacement that puts every ID of `bucket` in a free slot
+  constexpr bool PlaceBucket(uint32_t bucket) {
+    size_t members[N] = {};
+    size_t count = 0;
+    for (size_t i = 0; i < N; i++) {
+      if (BucketOf(ids_[i]) == bucket) members[count++] = i;
+    }
+    // Two IDs with the same bucket and base slot cannot be separated
+    for (size_t a = 0; a < count; a++) {
+      for (size_t b = a + 1; b < count; b++) {
+        if (BaseSlotOf(ids_[members[a]]) == BaseSlotOf(ids_[members[b]])) {
+          return false;
+        }
+      }
+    }
+
+    for (uint32_t d = 0; d < kTableSize; d++) {
+      bool fits = true;
+      for (size_t m = 0; m < count && fits; m++) {
+        fits = keys_[BaseSlotOf(ids_[members[m]]) ^ d] == CanIdLookup::kEmptyKey;
+      }
+      if (!fits) continue;
+      for (size_t m = 0; m < count; m++) {
+        uint32_t slot = BaseSlotOf(ids_[members[m]]) ^ d;
+        keys_[slot] = ids_[members[m]];
+        indices_[slot] = static_cast<uint8_t>(members[m]);
+      }
+      displacements_[bucket] = static_cast<uint16_t>(d);
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t ids_[N];
+  uint32_t keys_[kTableSize];
+  uint8_t indices_[kTableSize];
+  uint16_t displacements_[kBuckets];
+  uint32_t bucket_multiplier_;
+  uint32_t slot_multiplier_;
+  bool extended_;
+  bool valid_;
+};
+#endif  // __cplusplus >= 201402L
+
+#endif  // PROJECT_CAN_ID_SET_H_
@@ -0,0 +1,113 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_CAN_MPSC_QUEUE_H_
+#define PROJECT_CAN_MPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <new>
+
+// Bounded lock-free multi-producer / single-consumer queue (Vyukov).
+//
+// Every cell carries a sequence number. A producer claims a slot with one
+// compare-and-swap on the enqueue position and publishes it by bumping the
+// cell sequence, so producers never wait for each other and items from one
+// producer come out in the order they went in. Exactly one task may Pop().
+// Storage is allocated once by Init(); Init() and Free() must not race
+// with Push()/Pop(). Push/Pop are force-inlined like CanRingBuffer's, so
+// they run from IRAM inside WAVESHARE_CAN_HOT callers.
+template <typename T>
+class CanMpscQueue {
+ public:
+  CanMpscQueue()
+      : cells_(nullptr), mask_(0), enqueue_pos_(0), dequeue_pos_(0) {}
+  ~CanMpscQueue() { Free(); }
+
+  CanMpscQueue(const CanMpscQueue&) = delete;
+  CanMpscQueue& operator=(const CanMpscQueue&) = delete;
+
+  // Allocate room for at least `capacity` items (rounded up to a power of
+  // two). Returns false if out of memory.
+  bool Init(size_t capacity) {
+    Free();
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    cells_ = new (std::nothrow) Cell[size];
+    if (cells_ == nullptr) return false;
+    for (size_t i = 0; i < size; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask_ = size - 1;
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_release);
+    return true;
+  }
+
+  void Free() {
+    delete[] cells_;
+    cells_ = nullptr;
+    mask_ = 0;
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_relaxed);
+  }
+
+  // Any task. Returns false if full.
+  __attribute__((always_inline)) bool Push(const T& item) {
+    uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+      int32_t diff = static_cast<int32_t>(seq - pos);
+      if (diff == 0) {
+        // Slot free - claim it (pos is reloaded on failure)
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // Consumer has not freed this cell yet
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = item;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Single consumer. Returns false if empty (or the oldest claimed slot is
+  // still being written by its producer).
+  __attribute__((always_inline)) bool Pop(T* item) {
+    uint32_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell* cell = &cells_[pos & mask_];
+    uint32_t seq = cell->sequence.load(std::memory_order_acquire);
+    if (static_cast<int32_t>(seq - (pos + 1)) < 0) return false;
+    *item = cell->data;
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    dequeue_pos_.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate while producers are active
+  size_t Size() const {
+    // Dequeue first: enqueue_pos_ never trails it, so no underflow
+    uint32_t tail = dequeue_pos_.load(std::memory_order_acquire);
+    return enqueue_pos_.load(std::memory_order_acquire) - tail;
+  }
+
+  size_t Capacity() const { return cells_ ? mask_ + 1 : 0; }
+
+ private:
+  struct Cell {
+    std::atomic<uint32_t> sequence;
+    T data;
+  };
+
+  Cell* cells_;
+  uint32_t mask_;
+  std::atomic<uint32_t> enqueue_pos_;
+  std::atomic<uint32_t> dequeue_pos_;
+};
+
+#endif  // PROJECT_CAN_MPSC_QUEUE_H_
@@ -0,0 +1,87 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_CAN_RING_BUFFER_H_
+#define PROJECT_CAN_RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer / single-consumer ring buffer.
+//
+// One context (task or ISR) may Push(), one other context may Pop(). No
+// locks, no allocation, safe to use from an ISR. Capacity must be a power
+// of two; indices run freely and wrap through the mask. Push/Pop are
+// force-inlined so an IRAM interrupt handler never calls into flash.
+template <typename T, size_t kCapacity>
+class CanRingBuffer {
+  static_assert(kCapacity >= 2 && (kCapacity & (kCapacity - 1)) == 0,
+                "CanRingBuffer capacity must be a power of two");
+
+ public:
+  CanRingBuffer() : head_(0), tail_(0) {}
+
+  CanRingBuffer(const CanRingBuffer&) = delete;
+  CanRingBuffer& operator=(const CanRingBuffer&) = delete;
+
+  // Producer side. Returns false if full.
+  __attribute__((always_inline)) bool Push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kCapacity) return false;
+    items_[head & kMask] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if empty.
+  __attribute__((always_inline)) bool Pop(T* item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    *item = items_[tail & kMask];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, zero-copy: the oldest item in place plus the number of
+  // items stored contiguously after it (up to the wrap point). Returns
+  // nullptr and *count = 0 if empty. Items stay valid until Release().
+  __attribute__((always_inline)) const T* Peek(size_t* count) const {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    size_t avail = head_.load(std::memory_order_acquire) - tail;
+    size_t contiguous = kCapacity - (tail & kMask);
+    if (avail > contiguous) avail = contiguous;
+    *count = avail;
+    return avail ? &items_[tail & kMask] : nullptr;
+  }
+
+  // Consumer side: drop n items previously returned by Peek()
+  __attribute__((always_inline)) void Release(size_t n) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    size_t avail = head_.load(std::memory_order_acquire) - tail;
+    if (n > avail) n = avail;
+    tail_.store(tail + n, std::memory_order_release);
+  }
+
+  size_t Size() const {
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    return head_.load(std::memory_order_acquire) - tail;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  static constexpr size_t Capacity() { return kCapacity; }
+
+  // Drop everything. Only call while neither side is running.
+  void Clear() {
+    tail_.store(head_.load(std::memory_order_acquire),
+                std::memory_order_release);
+  }
+
+ private:
+  static constexpr uint32_t kMask = kCapacity - 1;
+
+  std::atomic<uint32_t> head_;  // Written by producer only
+  std::atomic<uint32_t> tail_;  // Written by consumer only
+  T items_[kCapacity];
+};
+
+#endif  // PROJECT_CAN_RING_BUFFER_H_
@@ -0,0 +1,153 @@
+// Copyright 2026 p43lz3r
+#include "can_rules.h"
+
+#include <math.h>
+#include <string.h>
+#include "waveshare_can_attrs.h"
+
+namespace {
+
+CanRule BaseRule(uint32_t id, bool extended) {
+  CanRule rule = {};
+  rule.identifier = id;
+  rule.extended = extended;
+  rule.compare = kRuleAny;
+  rule.gpio_pin = -1;
+  return rule;
+}
+
+void SetField(CanRule* rule, uint8_t start_bit, uint8_t length,
+              bool is_signed) {
+  if (start_bit > 63) start_bit = 63;
+  if (length < 1) length = 1;
+  if (length > 64 - start_bit) length = 64 - start_bit;
+  rule->start_bit = start_bit;
+  rule->length = length;
+  rule->is_signed = is_signed;
+  rule->min_dlc = (start_bit + length + 7) / 8;
+}
+
+// Swap the comparison when both sides are multiplied by a negative scale
+CanRuleCompare Mirror(CanRuleCompare compare) {
+  switch (compare) {
+    case kRuleLt: return kRuleGt;
+    case kRuleLe: return kRuleGe;
+    case kRuleGt: return kRuleLt;
+    case kRuleGe: return kRuleLe;
+    default: return compare;
+  }
+}
+
+}  // namespace
+
+CanRule CanRule::OnFrame(uint32_t id, bool extended) {
+  return BaseRule(id, extended);
+}
+
+CanRule CanRule::OnBits(uint32_t id, bool extended, uint8_t start_bit,
+                        uint8_t length, uint64_t value) {
+  CanRule rule = BaseRule(id, extended);
+  SetField(&rule, start_bit, length, false);
+  rule.compare = kRuleEq;
+  rule.threshold = static_cast<int64_t>(value);
+  return rule;
+}
+
+CanRule CanRule::OnSignal(uint32_t id, bool extended, const CanSignal& signal,
+                          CanRuleCompare compare, float threshold) {
+  CanRule rule = BaseRule(id, extended);
+  SetField(&rule, signal.start_bit, signal.length, signal.is_signed);
+  rule.compare = compare;
+  if (compare == kRuleAny || compare == kRuleNever) return rule;
+  if (signal.scale == 0.0f) {
+    rule.compare = kRuleNever;
+    return rule;
+  }
+
+  // physical OP threshold  <=>  raw OP' (threshold - offset) / scale
+  double raw = (static_cast<double>(threshold) - signal.offset) / signal.scale;
+  if (signal.scale < 0.0f) compare = Mirror(compare);
+
+  // The threshold is a float, so a value on a raw step (12.0 / 0.1f =
+  // 119.99999...) arrives slightly off; snap it back before rounding
+  double nearest = round(raw);
+  bool on_step = fabs(raw - nearest) <= 1e-6 * (fabs(raw) + 1.0);
+  if (on_step) raw = nearest;
+
+  // Round so that the integer compare accepts exactly the raw values whose
+  // physical value satisfies the original condition
+  double limit;
+  switch (compare) {
+    case kRuleLt:
+    case kRuleGe:
+      limit = ceil(raw);
+      break;
+    case kRuleLe:
+    case kRuleGt:
+      limit = floor(raw);
+      break;
+    default:  // Eq / Ne: only an exact raw step can be equal
+      limit = nearest;
+      if (!on_step && compare == kRuleEq) compare = kRuleNever;
+      if (!on_step && compare == kRuleNe) {
+        // Every raw value passes, but unlike kRuleAny the frame must still
+        // be a data frame long enough to hold the signal
+        rule.compare = kRuleGe;
+        rule.threshold = INT64_MIN;
+        return rule;
+      }
+      break;
+  }
+
+  // Clamp to the signal's raw range so out-of-range thresholds stay correct
+  double lo = signal.is_signed ? -ldexp(1.0, rule.length - 1) : 0.0;
+  double hi = signal.is_signed ? ldexp(1.0, rule.length - 1) - 1.0
+                               : ldexp(1.0, rule.length) - 1.0;
+  if (limit < lo - 1.0) limit = lo - 1.0;
+  if (limit > hi + 1.0) limit = hi + 1.0;
+  if (limit > 9.2e18) limit = 9.2e18;  // 64-bit signals
+  rule.compare = compare;
+  rule.threshold = static_cast<int64_t>(limit);
+  return rule;
+}
+
+CanRule& CanRule::ThenSend(const twai_message_t& message) {
+  tx = message;
+  actions |= kActionSend;
+  return *this;
+}
+
+CanRule& CanRule::ThenGpio(int pin, uint8_t level) {
+  gpio_pin = static_cast<int8_t>(pin);
+  gpio_level = level;
+  actions |= kActionGpio;
+  return *this;
+}
+
+bool WAVESHARE_CAN_HOT CanRule::Matches(const twai_message_t& msg) const {
+  if (msg.identifier != identifier || msg.extd != extended) return false;
+  if (compare == kRuleAny) return true;
+  if (msg.rtr || msg.data_length_code < min_dlc) return false;
+
+  uint64_t payload;
+  memcpy(&payload, msg.data, sizeof(payload));  // Xtensa is little-endian
+  payload >>= start_bit;
+  int64_t value;
+  if (length >= 64) {
+    value = static_cast<int64_t>(payload);
+  } else if (is_signed) {
+    value = static_cast<int64_t>(payload << (64 - length)) >> (64 - length);
+  } else {
+    value = static_cast<int64_t>(payload & ((1ULL << length) - 1));
+  }
+
+  switch (compare) {
+    case kRuleEq: return value == threshold;
+    case kRuleNe: return value != threshold;
+    case kRuleLt: return value < threshold;
+    case kRuleLe: return value <= threshold;
+    case kRuleGt: return value > threshold;
+    case kRuleGe: return value >= threshold;
+    default: return false;
+  }
+}
@@ -0,0 +1,88 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_CAN_RULES_H_
+#define PROJECT_CAN_RULES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+// Reactive rules evaluated in the RX task: a condition on one received
+// frame triggers a precomputed TX frame and/or a GPIO level, without a
+// round trip through loop().
+//
+//   CanSignal speed = {16, 16, false, 0.01f, 0.0f};  // km/h
+//   can.AddRule(CanRule::OnSignal(0x0CF00400, true, speed, kRuleGt, 120.0f)
+//                   .ThenSend(stop_frame)
+//                   .ThenGpio(RELAY_PIN, 0));
+//
+// Building a rule converts the physical threshold into a raw integer once,
+// so the RX path only extracts the bits and does one integer compare.
+
+enum CanRuleCompare : uint8_t {
+  kRuleAny,  // Every frame with the ID
+  kRuleEq,
+  kRuleNe,
+  kRuleLt,
+  kRuleLe,
+  kRuleGt,
+  kRuleGe,
+  kRuleNever  // Threshold unreachable (e.g. == a value between raw steps)
+};
+
+// Little-endian (Intel) signal, as in CanTxHandle::SetSignal():
+// physical = raw * scale + offset
+struct CanSignal {
+  uint8_t start_bit;  // Bit 0 = LSB of data[0]
+  uint8_t length;     // 1..64
+  bool is_signed;     // Two's complement raw value
+  float scale;
+  float offset;
+};
+
+// One compiled rule (one table entry)
+struct CanRule {
+  // Action flags
+  static constexpr uint8_t kActionSend = 0x01;
+  static constexpr uint8_t kActionGpio = 0x02;
+
+  uint32_t identifier;
+  bool extended;
+  uint8_t start_bit;
+  uint8_t length;
+  bool is_signed;
+  uint8_t min_dlc;   // Frames too short to hold the signal never match
+  uint8_t compare;   // CanRuleCompare on the raw value
+  uint8_t actions;
+  int8_t gpio_pin;
+  uint8_t gpio_level;
+  int64_t threshold;  // Raw
+  twai_message_t tx;
+
+  // Any frame with this ID
+  static CanRule OnFrame(uint32_t id, bool extended);
+
+  // Raw bits: `length` bits at `start_bit` equal `value` (payload flags)
+  static CanRule OnBits(uint32_t id, bool extended, uint8_t start_bit,
+                        uint8_t length, uint64_t value);
+
+  // Scaled signal compared against a physical threshold
+  static CanRule OnSignal(uint32_t id, bool extended, const CanSignal& signal,
+                          CanRuleCompare compare, float threshold);
+
+  CanRule& ThenSend(const twai_message_t& message);
+  CanRule& ThenGpio(int pin, uint8_t level);
+
+  // Condition check, called by the RX task
+  bool Matches(const twai_message_t& msg) const;
+};
+
+// Per-rule counters (see WaveshareCan::GetRuleStats)
+struct CanRuleStats {
+  uint32_t fired;           // Condition matched, actions run
+  uint32_t tx_failed;       // Reaction frame not accepted by the TX path
+  uint32_t last_latency_us; // RX task pickup to last action done
+  uint32_t max_latency_us;
+  uint64_t total_latency_us;
+};
+
+#endif  // PROJECT_CAN_RULES_H_
@@ -0,0 +1,47 @@
+// Copyright 2026 p43lz3r
+#include "twai_register_backend.h"
+
+#ifdef ESP_PLATFORM
+#include "driver/gpio.h"
+#include "esp_idf_version.h"
+#include "esp_rom_gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/periph_defs.h"
+// periph_module_*() moved out of the public driver API in IDF 5
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_private/periph_ctrl.h"
+#else
+#include "driver/periph_ctrl.h"
+#endif
+
+bool TwaiLowLevelAttach(int tx_pin, int rx_pin) {
+  if (!GPIO_IS_VALID_OUTPUT_GPIO(tx_pin) || !GPIO_IS_VALID_GPIO(rx_pin)) {
+    return false;
+  }
+
+  periph_module_reset(PERIPH_TWAI_MODULE);
+  periph_module_enable(PERIPH_TWAI_MODULE);
+
+  gpio_num_t tx = static_cast<gpio_num_t>(tx_pin);
+  gpio_num_t rx = static_cast<gpio_num_t>(rx_pin);
+  esp_rom_gpio_pad_select_gpio(tx);
+  gpio_set_direction(tx, GPIO_MODE_OUTPUT);
+  esp_rom_gpio_connect_out_signal(tx, TWAI_TX_IDX, false, false);
+
+  esp_rom_gpio_pad_select_gpio(rx);
+  gpio_set_direction(rx, GPIO_MODE_INPUT);
+  esp_rom_gpio_connect_in_signal(rx, TWAI_RX_IDX, false);
+  return true;
+}
+
+void TwaiLowLevelDetach() {
+  periph_module_disable(PERIPH_TWAI_MODULE);
+}
+
+esp_err_t TwaiLowLevelInstallIsr(void (*handler)(void*), void* arg, bool iram,
+                                 intr_handle_t* handle) {
+  int flags = ESP_INTR_FLAG_LOWMED;
+  if (iram) flags |= ESP_INTR_FLAG_IRAM;
+  return esp_intr_alloc(ETS_TWAI_INTR_SOURCE, flags, handler, arg, handle);
+}
+#endif  // ESP_PLATFORM
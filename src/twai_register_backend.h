@@ -0,0 +1,673 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_TWAI_REGISTER_BACKEND_H_
+#define PROJECT_TWAI_REGISTER_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "can_ring_buffer.h"
+#ifdef ESP_PLATFORM
+#include "driver/twai.h"
+#include "esp_attr.h"
+#include "esp_intr_alloc.h"
+#include "sdkconfig.h"
+#include "soc/soc.h"
+#else
+// Host builds (TwaiRegisterModel tests) get stand-ins for the driver types
+// the backend uses, so no IDF header is needed
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+typedef enum {
+  TWAI_STATE_STOPPED,
+  TWAI_STATE_RUNNING,
+  TWAI_STATE_BUS_OFF,
+  TWAI_STATE_RECOVERING
+} twai_state_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t extd : 1;
+      uint32_t rtr : 1;
+      uint32_t ss : 1;
+      uint32_t self : 1;
+      uint32_t dlc_non_comp : 1;
+      uint32_t reserved : 27;
+    };
+    uint32_t flags;
+  };
+  uint32_t identifier;
+  uint8_t data_length_code;
+  uint8_t data[8];
+} twai_message_t;
+
+typedef struct {
+  uint32_t brp;
+  uint8_t tseg_1;
+  uint8_t tseg_2;
+  uint8_t sjw;
+  bool triple_sampling;
+} twai_timing_config_t;
+
+typedef struct {
+  uint32_t acceptance_code;
+  uint32_t acceptance_mask;
+  bool single_filter;
+} twai_filter_config_t;
+
+typedef struct {
+  twai_state_t state;
+  uint32_t msgs_to_tx;
+  uint32_t msgs_to_rx;
+  uint32_t tx_error_counter;
+  uint32_t rx_error_counter;
+  uint32_t tx_failed_count;
+  uint32_t rx_missed_count;
+  uint32_t rx_overrun_count;
+  uint32_t arb_lost_count;
+  uint32_t bus_error_count;
+} twai_status_info_t;
+#endif  // ESP_PLATFORM
+
+// Register-level TWAI backend.
+//
+// Drives the SJA1000-compatible TWAI controller directly instead of going
+// through the IDF driver: the interrupt handler copies each frame from the
+// controller's RX buffer straight into a lock-free ring owned by the
+// library, optionally after an ISR-level filter. No driver queue, no
+// semaphores, one copy per frame.
+//
+// All register access goes through the Io template parameter (Read/Write of
+// 32-bit registers by byte offset), so the same code runs against the real
+// peripheral (TwaiMmio) or against TwaiRegisterModel on a host.
+
+// Register offsets (PeliCAN layout, one byte per 32-bit word)
+namespace twai_reg {
+constexpr uint32_t kMode = 0x00;
+constexpr uint32_t kCommand = 0x04;
+constexpr uint32_t kStatus = 0x08;
+constexpr uint32_t kInterrupt = 0x0C;  // Read clears
+constexpr uint32_t kInterruptEnable = 0x10;
+constexpr uint32_t kBusTiming0 = 0x18;
+constexpr uint32_t kBusTiming1 = 0x1C;
+constexpr uint32_t kArbLostCapture = 0x2C;
+constexpr uint32_t kErrorCodeCapture = 0x30;
+constexpr uint32_t kErrorWarningLimit = 0x34;
+constexpr uint32_t kRxErrorCount = 0x38;
+constexpr uint32_t kTxErrorCount = 0x3C;
+constexpr uint32_t kFrameBuffer = 0x40;       // 13 bytes: info, ID, data
+constexpr uint32_t kAcceptanceCode = 0x40;    // 4 bytes, reset mode only
+constexpr uint32_t kAcceptanceMask = 0x50;    // 4 bytes, reset mode only
+constexpr uint32_t kRxMessageCount = 0x74;
+constexpr uint32_t kClockDivider = 0x7C;
+constexpr uint32_t kRegisterSpan = 0x80;
+
+// kBusTiming0 layout. The ESP32-S3/C3 controller widens the prescaler to
+// 14 bits and moves SJW to bit 14; the original ESP32 keeps the SJA1000
+// layout (6-bit prescaler, SJW at bit 6), so brp above 128 is not
+// supported there.
+#if defined(CONFIG_IDF_TARGET_ESP32)
+constexpr uint32_t kBtr0SjwShift = 6;
+#else
+constexpr uint32_t kBtr0SjwShift = 14;
+#endif
+
+// kMode bits
+constexpr uint32_t kModeReset = 1u << 0;
+constexpr uint32_t kModeListenOnly = 1u << 1;
+constexpr uint32_t kModeSelfTest = 1u << 2;
+constexpr uint32_t kModeSingleFilter = 1u << 3;
+
+// kCommand bits
+constexpr uint32_t kCmdTxRequest = 1u << 0;
+constexpr uint32_t kCmdAbortTx = 1u << 1;
+constexpr uint32_t kCmdReleaseRxBuffer = 1u << 2;
+constexpr uint32_t kCmdClearOverrun = 1u << 3;
+constexpr uint32_t kCmdSelfRxRequest = 1u << 4;
+
+// kStatus bits
+constexpr uint32_t kStatusRxBuffer = 1u << 0;  // Frame available
+constexpr uint32_t kStatusOverrun = 1u << 1;
+constexpr uint32_t kStatusTxBuffer = 1u << 2;  // TX buffer free
+constexpr uint32_t kStatusTxComplete = 1u << 3;
+constexpr uint32_t kStatusErrorWarning = 1u << 6;  // A counter >= warning limit
+constexpr uint32_t kStatusBusOff = 1u << 7;
+
+// kInterrupt / kInterruptEnable bits
+constexpr uint32_t kIntRx = 1u << 0;
+constexpr uint32_t kIntTx = 1u << 1;            // TX buffer released
+constexpr uint32_t kIntErrorWarning = 1u << 2;  // Error or bus-off bit changed
+constexpr uint32_t kIntOverrun = 1u << 3;
+constexpr uint32_t kIntErrorPassive = 1u << 5;  // Entered or left error passive
+constexpr uint32_t kIntArbLost = 1u << 6;
+constexpr uint32_t kIntBusError = 1u << 7;
+
+// Frame info byte
+constexpr uint8_t kInfoExtended = 0x80;
+constexpr uint8_t kInfoRtr = 0x40;
+constexpr uint8_t kInfoDlcMask = 0x0F;
+constexpr size_t kFrameBytes = 13;
+
+// Error counter level at which the controller goes error passive
+constexpr uint32_t kErrorPassiveLimit = 128;
+
+// Frame buffer layout: info byte, 2 (std) or 4 (ext) ID bytes, data.
+// Returns the number of bytes used.
+__attribute__((always_inline)) inline size_t EncodeFrame(const twai_message_t& msg, uint8_t* buf) {
+  uint8_t dlc = msg.data_length_code > 8 ? 8 : msg.data_length_code;
+  buf[0] = dlc | (msg.extd ? kInfoExtended : 0) | (msg.rtr ? kInfoRtr : 0);
+  size_t pos;
+  if (msg.extd) {
+    uint32_t id = msg.identifier << 3;
+    buf[1] = id >> 24;
+    buf[2] = id >> 16;
+    buf[3] = id >> 8;
+    buf[4] = id;
+    pos = 5;
+  } else {
+    uint32_t id = msg.identifier << 5;
+    buf[1] = id >> 8;
+    buf[2] = id;
+    pos = 3;
+  }
+  if (!msg.rtr) {
+    memcpy(buf + pos, msg.data, dlc);
+    pos += dlc;
+  }
+  return pos;
+}
+
+__attribute__((always_inline)) inline void DecodeFrame(const uint8_t* buf, twai_message_t* msg) {
+  *msg = twai_message_t();
+  uint8_t info = buf[0];
+  uint8_t dlc = info & kInfoDlcMask;
+  msg->extd = (info & kInfoExtended) ? 1 : 0;
+  msg->rtr = (info & kInfoRtr) ? 1 : 0;
+  msg->data_length_code = dlc > 8 ? 8 : dlc;
+  size_t pos;
+  if (msg->extd) {
+    msg->identifier = ((uint32_t)buf[1] << 21) | ((uint32_t)buf[2] << 13) |
+                      ((uint32_t)buf[3] << 5) | (buf[4] >> 3);
+    pos = 5;
+  } else {
+    msg->identifier = ((uint32_t)buf[1] << 3) | (buf[2] >> 5);
+    pos = 3;
+  }
+  if (!msg->rtr) memcpy(msg->data, buf + pos, msg->data_length_code);
+}
+
+}  // namespace twai_reg
+
+// ISR-level frame filter/callback. Runs in interrupt context for every
+// received frame - must be short, must not block, and must live in IRAM if
+// the interrupt is allocated with ESP_INTR_FLAG_IRAM. Return false to drop
+// the frame before it reaches the ring.
+typedef bool (*TwaiIsrFilter)(const twai_message_t& msg, void* arg);
+
+// ServiceInterrupt() result bits
+constexpr uint32_t kTwaiEventRx = 1u << 0;          // Frame(s) queued in the ring
+constexpr uint32_t kTwaiEventTxDone = 1u << 1;      // TX buffer may be free again
+constexpr uint32_t kTwaiEventErrorState = 1u << 2;  // Warning/passive/bus-off change
+constexpr uint32_t kTwaiEventBusOff = 1u << 3;      // Controller just went bus-off
+
+template <class Io, size_t kRingSize = 64>
+class TwaiRegisterBackend {
+ public:
+  explicit TwaiRegisterBackend(const Io& io = Io())
+      : io_(io),
+        isr_filter_(nullptr),
+        isr_filter_arg_(nullptr),
+        mode_(0),
+        bus_off_(false),
+        rx_dropped_count_(0),
+        rx_filtered_count_(0),
+        rx_overrun_count_(0),
+        arb_lost_count_(0),
+        bus_error_count_(0),
+        error_passive_count_(0),
+        bus_off_count_(0) {}
+
+  TwaiRegisterBackend(const TwaiRegisterBackend&) = delete;
+  TwaiRegisterBackend& operator=(const TwaiRegisterBackend&) = delete;
+
+  Io& io() { return io_; }
+
+  // Put the controller in reset mode and program timing, acceptance filter
+  // and error warning limit. Call Start() afterwards.
+  void Configure(const twai_timing_config_t& timing,
+                 const twai_filter_config_t& filter, bool listen_only) {
+    using namespace twai_reg;
+    io_.Write(kMode, kModeReset);
+#if defined(CONFIG_IDF_TARGET_ESP32)
+    io_.Write(kClockDivider, 0x80);  // Select PeliCAN register layout
+#endif
+    // Controller divides the APB clock by 2 * (BRP + 1)
+    io_.Write(kBusTiming0,
+              ((timing.sjw - 1u) << kBtr0SjwShift) | (timing.brp / 2 - 1));
+    io_.Write(kBusTiming1, (timing.tseg_1 - 1u) | ((timing.tseg_2 - 1u) << 4) |
+                               (timing.triple_sampling ? 0x80u : 0u));
+    for (uint32_t i = 0; i < 4; i++) {
+      uint32_t shift = 24 - 8 * i;
+      io_.Write(kAcceptanceCode + 4 * i, (filter.acceptance_code >> shift) & 0xFF);
+      io_.Write(kAcceptanceMask + 4 * i, (filter.acceptance_mask >> shift) & 0xFF);
+    }
+    io_.Write(kErrorWarningLimit, 96);
+    io_.Write(kInterruptEnable, 0);
+    mode_ = (listen_only ? kModeListenOnly : 0) |
+            (filter.single_filter ? kModeSingleFilter : 0);
+    io_.Read(kInterrupt);  // Discard stale interrupt flags
+  }
+
+  // Leave reset mode and enable interrupts
+  void Start() {
+    using namespace twai_reg;
+    ring_.Clear();
+    bus_off_ = false;
+    io_.Write(kInterruptEnable, kIntRx | kIntTx | kIntErrorWarning |
+                                    kIntOverrun | kIntErrorPassive |
+                                    kIntArbLost | kIntBusError);
+    io_.Write(kMode, mode_);
+  }
+
+  // Enter reset mode (stops RX and TX, interrupts off)
+  void Stop() {
+    using namespace twai_reg;
+    io_.Write(kInterruptEnable, 0);
+    io_.Write(kMode, mode_ | kModeReset);
+  }
+
+  // Only change while the interrupt is not allocated
+  void SetIsrFilter(TwaiIsrFilter filter, void* arg) {
+    isr_filter_ = filter;
+    isr_filter_arg_ = arg;
+  }
+
+  // Interrupt body: drain the controller RX buffer into the ring and track
+  // error state. Call from the peripheral ISR (or directly in a host test).
+  // Returns kTwaiEvent* bits for the caller to act on.
+  IRAM_ATTR uint32_t ServiceInterrupt() {
+    using namespace twai_reg;
+    uint32_t intr = io_.Read(kInterrupt);
+    uint32_t events = 0;
+
+    if (intr & kIntTx) events |= kTwaiEventTxDone;
+    if (intr & kIntErrorPassive) {
+      events |= kTwaiEventErrorState;
+      if ((io_.Read(kTxErrorCount) & 0xFF) >= kErrorPassiveLimit ||
+          (io_.Read(kRxErrorCount) & 0xFF) >= kErrorPassiveLimit) {
+        error_passive_count_++;
+      }
+    }
+    if (intr & kIntErrorWarning) {
+      events |= kTwaiEventErrorState;
+      bool bus_off = io_.Read(kStatus) & kStatusBusOff;
+      if (bus_off && !bus_off_) {
+        // The controller aborted any pending frame and entered reset mode
+        bus_off_count_++;
+        events |= kTwaiEventBusOff | kTwaiEventTxDone;
+      } else if (!bus_off && bus_off_) {
+        events |= kTwaiEventTxDone;  // Recovered - TX possible again
+      }
+      bus_off_ = bus_off;
+    }
+
+    if (intr & kIntArbLost) {
+      io_.Read(kArbLostCapture);  // Re-arm capture
+      arb_lost_count_++;
+    }
+    if (intr & kIntBusError) {
+      io_.Read(kErrorCodeCapture);
+      bus_error_count_++;
+    }
+
+    // Bounded so a flooded bus cannot pin the CPU inside the ISR
+    for (uint32_t n = 0; n < 64 && (io_.Read(kStatus) & kStatusRxBuffer); n++) {
+      twai_message_t msg;
+      ReadFrame(&msg);
+      io_.Write(kCommand, kCmdReleaseRxBuffer);
+
+      if (isr_filter_ && !isr_filter_(msg, isr_filter_arg_)) {
+        rx_filtered_count_++;
+        continue;
+      }
+      if (ring_.Push(msg)) {
+        events |= kTwaiEventRx;
+      } else {
+        rx_dropped_count_++;
+      }
+    }
+
+    if (intr & kIntOverrun) {
+      io_.Write(kCommand, kCmdClearOverrun);
+      rx_overrun_count_++;
+    }
+    return events;
+  }
+
+  // Begin bus-off recovery. On bus-off the controller enters reset mode;
+  // leaving it starts the 128 x 11 recessive bit sequence, after which the
+  // bus-off bit clears and kIntErrorWarning reports the controller back.
+  // Returns false if the controller is not bus-off. Safe from the ISR.
+  IRAM_ATTR bool StartRecovery() {
+    using namespace twai_reg;
+    if (!(io_.Read(kStatus) & kStatusBusOff)) return false;
+    io_.Write(kMode, mode_);
+    return true;
+  }
+
+  // Consumer side of the RX ring (single consumer)
+  bool Receive(twai_message_t* msg) { return ring_.Pop(msg); }
+  size_t Pending() const { return ring_.Size(); }
+
+  // Bus-off leaves the controller in reset mode, where the frame buffer
+  // offsets address the acceptance filter - never load it then
+  bool TxReady() {
+    using namespace twai_reg;
+    return (io_.Read(kStatus) & (kStatusTxBuffer | kStatusBusOff)) ==
+           kStatusTxBuffer;
+  }
+
+  // Load the TX buffer and request transmission. Returns false if the
+  // previous frame is still in the buffer or the controller is bus-off;
+  // kTwaiEventTxDone signals when to retry. Callers must serialize.
+  bool Transmit(const twai_message_t& msg) {
+    using namespace twai_reg;
+    if (!TxReady()) return false;
+
+    uint8_t buf[kFrameBytes];
+    size_t len = EncodeFrame(msg, buf);
+    for (size_t i = 0; i < len; i++) {
+      io_.Write(kFrameBuffer + 4 * i, buf[i]);
+    }
+    uint32_t cmd = msg.self ? kCmdSelfRxRequest : kCmdTxRequest;
+    if (msg.ss) cmd |= kCmdAbortTx;  // TR + AT = single shot
+    io_.Write(kCommand, cmd);
+    return true;
+  }
+
+  // Drop the frame waiting in the TX buffer - the register-level
+  // twai_clear_transmit_queue(). A frame already on the wire still
+  // finishes; kTwaiEventTxDone follows either way. Returns the number of
+  // frames that were waiting (0 or 1). Callers must serialize with
+  // Transmit().
+  uint32_t AbortTx() {
+    using namespace twai_reg;
+    if (io_.Read(kStatus) & kStatusTxBuffer) return 0;
+    io_.Write(kCommand, kCmdAbortTx);
+    return 1;
+  }
+
+  // The last requested frame went out (false after an abort, single-shot
+  // failure or bus-off)
+  bool LastTxSucceeded() {
+    return io_.Read(twai_reg::kStatus) & twai_reg::kStatusTxComplete;
+  }
+
+  // Status in the IDF driver's format, built from controller registers
+  void GetStatus(twai_status_info_t* status) {
+    using namespace twai_reg;
+    uint32_t sr = io_.Read(kStatus);
+    *status = twai_status_info_t();
+    if (sr & kStatusBusOff) {
+      status->state = (io_.Read(kMode) & kModeReset) ? TWAI_STATE_BUS_OFF
+                                                     : TWAI_STATE_RECOVERING;
+    } else if (io_.Read(kMode) & kModeReset) {
+      status->state = TWAI_STATE_STOPPED;
+    } else {
+      status->state = TWAI_STATE_RUNNING;
+    }
+    status->msgs_to_tx = (sr & kStatusTxBuffer) ? 0 : 1;
+    status->msgs_to_rx = ring_.Size();
+    status->tx_error_counter = io_.Read(kTxErrorCount) & 0xFF;
+    status->rx_error_counter = io_.Read(kRxErrorCount) & 0xFF;
+    status->rx_missed_count = rx_dropped_count_;
+    status->rx_overrun_count = rx_overrun_count_;
+    status->arb_lost_count = arb_lost_count_;
+    status->bus_error_count = bus_error_count_;
+  }
+
+  uint32_t GetFilteredCount() const { return rx_filtered_count_; }
+  uint32_t GetErrorPassiveCount() const { return error_passive_count_; }
+  uint32_t GetBusOffCount() const { return bus_off_count_; }
+
+ private:
+  // Only read as many bytes as the frame actually occupies
+  __attribute__((always_inline)) void ReadFrame(twai_message_t* msg) {
+    using namespace twai_reg;
+    uint8_t buf[kFrameBytes] = {};
+    buf[0] = io_.Read(kFrameBuffer);
+    uint8_t dlc = buf[0] & kInfoDlcMask;
+    size_t len = ((buf[0] & kInfoExtended) ? 5 : 3) +
+                 ((buf[0] & kInfoRtr) ? 0 : (dlc > 8 ? 8 : dlc));
+    for (size_t i = 1; i < len; i++) {
+      buf[i] = io_.Read(kFrameBuffer + 4 * i);
+    }
+    DecodeFrame(buf, msg);
+  }
+
+  Io io_;
+  CanRingBuffer<twai_message_t, kRingSize> ring_;
+  TwaiIsrFilter isr_filter_;
+  void* isr_filter_arg_;
+  uint32_t mode_;
+  volatile bool bus_off_;  // Last bus-off bit seen by the ISR
+  volatile uint32_t rx_dropped_count_;   // Ring full
+  volatile uint32_t rx_filtered_count_;  // Rejected by the ISR filter
+  volatile uint32_t rx_overrun_count_;   // Controller FIFO overrun
+  volatile uint32_t arb_lost_count_;
+  volatile uint32_t bus_error_count_;
+  volatile uint32_t error_passive_count_;  // Entries into error passive
+  volatile uint32_t bus_off_count_;
+};
+
+// Software model of the controller registers for host builds. Covers what
+// TwaiRegisterBackend touches: reset/operating mode, an RX FIFO fed by
+// InjectRxFrame(), a TX buffer captured into a log, the read-to-clear
+// interrupt register, error counters with their warning/passive/bus-off
+// transitions, and bus-off recovery.
+class TwaiRegisterModel {
+ public:
+  static constexpr size_t kFifoFrames = 8;
+  static constexpr size_t kTxLogFrames = 16;
+
+  TwaiRegisterModel()
+      : regs_(), rx_(), rx_head_(0), rx_count_(0), tx_buffer_(), tx_(),
+        tx_head_(0), tx_count_(0), tx_busy_(false), tx_complete_(true),
+        hold_tx_(false), bus_off_(false) {
+    regs_[twai_reg::kMode / 4] = twai_reg::kModeReset;
+    regs_[twai_reg::kErrorWarningLimit / 4] = 96;
+  }
+
+  uint32_t Read(uint32_t offset) {
+    using namespace twai_reg;
+    uint32_t index = (offset % kRegisterSpan) / 4;
+    if (offset == kInterrupt) {
+      uint32_t value = regs_[index];
+      regs_[index] = 0;
+      return value;
+    }
+    if (offset == kStatus) {
+      return (tx_busy_ ? 0 : kStatusTxBuffer) |
+             (tx_complete_ ? kStatusTxComplete : 0) |
+             (rx_count_ > 0 ? kStatusRxBuffer : 0) |
+             (ErrorWarning() ? kStatusErrorWarning : 0) |
+             (bus_off_ ? kStatusBusOff : 0);
+    }
+    if (offset == kRxMessageCount) return rx_count_;
+    if (offset >= kFrameBuffer && offset < kFrameBuffer + 4 * kFrameBytes &&
+        !InReset()) {
+      return rx_count_ > 0 ? rx_[rx_head_][(offset - kFrameBuffer) / 4] : 0;
+    }
+    return regs_[index];
+  }
+
+  void Write(uint32_t offset, uint32_t value) {
+    using namespace twai_reg;
+    uint32_t index = (offset % kRegisterSpan) / 4;
+    if (offset == kCommand) {
+      if ((value & kCmdReleaseRxBuffer) && rx_count_ > 0) {
+        rx_head_ = (rx_head_ + 1) % kFifoFrames;
+        rx_count_--;
+      }
+      if ((value & (kCmdTxRequest | kCmdSelfRxRequest)) && !InReset()) {
+        tx_busy_ = true;
+        tx_complete_ = false;
+        if (!hold_tx_) CompleteTx();
+      } else if ((value & kCmdAbortTx) && tx_busy_) {
+        // Still waiting for the bus - released without being sent
+        tx_busy_ = false;
+        Raise(kIntTx);
+      }
+      return;
+    }
+    if (offset >= kFrameBuffer && offset < kFrameBuffer + 4 * kFrameBytes &&
+        !InReset()) {
+      tx_buffer_[(offset - kFrameBuffer) / 4] = value;
+      return;
+    }
+    regs_[index] = value;
+  }
+
+  // Queue a frame as if it arrived from the bus. Returns false on overrun.
+  bool InjectRxFrame(const twai_message_t& msg) {
+    using namespace twai_reg;
+    if (InReset()) return false;
+    if (rx_count_ == kFifoFrames) {
+      Raise(kIntOverrun);
+      return false;
+    }
+    uint8_t* slot = rx_[(rx_head_ + rx_count_) % kFifoFrames];
+    memset(slot, 0, kFrameBytes);
+    twai_reg::EncodeFrame(msg, slot);
+    rx_count_++;
+    Raise(kIntRx);
+    return true;
+  }
+
+  // Oldest frame written to the TX buffer and requested for transmission
+  bool TakeTxFrame(twai_message_t* msg) {
+    if (tx_count_ == 0) return false;
+    twai_reg::DecodeFrame(tx_[tx_head_], msg);
+    tx_head_ = (tx_head_ + 1) % kTxLogFrames;
+    tx_count_--;
+    return true;
+  }
+
+  // Keep requested frames in the TX buffer until CompleteTx(), as if the
+  // bus were busy
+  void HoldTx(bool hold) { hold_tx_ = hold; }
+
+  // The frame in the TX buffer went out: log it and release the buffer
+  bool CompleteTx() {
+    if (!tx_busy_) return false;
+    memcpy(tx_[(tx_head_ + tx_count_) % kTxLogFrames], tx_buffer_,
+           twai_reg::kFrameBytes);
+    if (tx_count_ < kTxLogFrames) {
+      tx_count_++;
+    } else {
+      tx_head_ = (tx_head_ + 1) % kTxLogFrames;
+    }
+    tx_busy_ = false;
+    tx_complete_ = true;
+    Raise(twai_reg::kIntTx);
+    return true;
+  }
+
+  // Interrupt line: an enabled interrupt flag is set
+  bool IrqPending() const {
+    return regs_[twai_reg::kInterrupt / 4] & regs_[twai_reg::kInterruptEnable / 4];
+  }
+
+  // Raises the error warning / error passive interrupts on the transitions
+  // the counters cause
+  void SetErrorCounters(uint8_t tec, uint8_t rec) {
+    using namespace twai_reg;
+    bool warning = ErrorWarning();
+    bool passive = ErrorPassive();
+    regs_[kTxErrorCount / 4] = tec;
+    regs_[kRxErrorCount / 4] = rec;
+    if (ErrorWarning() != warning) Raise(kIntErrorWarning);
+    if (ErrorPassive() != passive) Raise(kIntErrorPassive);
+  }
+
+  // TX error counter overflow: abort the pending frame, enter reset mode
+  void EnterBusOff() {
+    using namespace twai_reg;
+    if (bus_off_) return;
+    bus_off_ = true;
+    tx_busy_ = false;
+    regs_[kMode / 4] |= kModeReset;
+    regs_[kTxErrorCount / 4] = 127;
+    regs_[kRxErrorCount / 4] = 0;
+    Raise(kIntErrorWarning);
+  }
+
+  // The 128 x 11 recessive bits after software left reset mode have been
+  // seen: the controller is error active again. False if not recovering.
+  bool FinishRecovery() {
+    using namespace twai_reg;
+    if (!bus_off_ || InReset()) return false;
+    bus_off_ = false;
+    regs_[kTxErrorCount / 4] = 0;
+    regs_[kRxErrorCount / 4] = 0;
+    Raise(kIntErrorWarning);
+    return true;
+  }
+
+ private:
+  bool InReset() const { return regs_[twai_reg::kMode / 4] & twai_reg::kModeReset; }
+  void Raise(uint32_t bits) { regs_[twai_reg::kInterrupt / 4] |= bits; }
+
+  bool ErrorWarning() const {
+    using namespace twai_reg;
+    uint32_t limit = regs_[kErrorWarningLimit / 4];
+    return regs_[kTxErrorCount / 4] >= limit || regs_[kRxErrorCount / 4] >= limit;
+  }
+
+  bool ErrorPassive() const {
+    using namespace twai_reg;
+    return regs_[kTxErrorCount / 4] >= kErrorPassiveLimit ||
+           regs_[kRxErrorCount / 4] >= kErrorPassiveLimit;
+  }
+
+  uint32_t regs_[twai_reg::kRegisterSpan / 4];
+  uint8_t rx_[kFifoFrames][twai_reg::kFrameBytes];
+  size_t rx_head_;
+  size_t rx_count_;
+  uint8_t tx_buffer_[twai_reg::kFrameBytes];
+  uint8_t tx_[kTxLogFrames][twai_reg::kFrameBytes];
+  size_t tx_head_;
+  size_t tx_count_;
+  bool tx_busy_;      // Frame requested, not yet sent
+  bool tx_complete_;  // Last requested frame was sent
+  bool hold_tx_;
+  bool bus_off_;
+};
+
+#ifdef ESP_PLATFORM
+// Memory-mapped access to the on-chip TWAI controller
+struct TwaiMmio {
+  __attribute__((always_inline)) static uint32_t Read(uint32_t offset) {
+    return *reinterpret_cast<volatile uint32_t*>(kBase + offset);
+  }
+  __attribute__((always_inline)) static void Write(uint32_t offset,
+                                                  uint32_t value) {
+    *reinterpret_cast<volatile uint32_t*>(kBase + offset) = value;
+  }
+  static constexpr uintptr_t kBase = DR_REG_TWAI_BASE;
+};
+
+// Platform glue (twai_register_backend.cc): clock/reset the peripheral and
+// route the TX/RX pins through the GPIO matrix
+bool TwaiLowLevelAttach(int tx_pin, int rx_pin);
+void TwaiLowLevelDetach();
+
+// Allocate the TWAI interrupt. Pass iram = true only if the handler and
+// everything it calls (including an ISR filter) is IRAM resident.
+esp_err_t TwaiLowLevelInstallIsr(void (*handler)(void*), void* arg, bool iram,
+                                 intr_handle_t* handle);
+#endif  // ESP_PLATFORM
+
+#endif  // PROJECT_TWAI_REGISTER_BACKEND_H_
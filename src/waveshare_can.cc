@@ -1,76 +1,367 @@
 // Copyright 2026 by p43lz3r
 #include "waveshare_can.h"
 
+#include "driver/gpio.h"
 
 WaveshareCan::WaveshareCan(BoardType board, int rx_pin, int tx_pin)
     : board_type_(board),
       rx_pin_(rx_pin >= 0 ? rx_pin : (board == kBoard43b ? 16 : 19)),
       tx_pin_(tx_pin >= 0 ? tx_pin : (board == kBoard43b ? 15 : 20)),
       initialized_(false),
+      low_level_(false),
       listen_only_(false),
       alert_interrupt_enabled_(false),
       rx_interrupt_enabled_(false),
+      rx_busy_poll_core_(-1),
+      tx_queue_enabled_(false),
       shutdown_(false),
       alert_callback_(nullptr),
       rx_callback_(nullptr),
+      rx_batch_callback_(nullptr),
       alert_task_handle_(nullptr),
       rx_task_handle_(nullptr),
-      rx_queue_(nullptr),
+      tx_task_handle_(nullptr),
+      rx_stack_words_(kRxTaskStackSize),
+      alert_stack_words_(kAlertTaskStackSize),
+      tx_stack_words_(kTxTaskStackSize),
+      rx_task_start_us_(0),
+      alert_task_start_us_(0),
+      tx_task_start_us_(0),
+      rx_run_time_(),
+      alert_run_time_(),
+      tx_run_time_(),
+      tx_queue_(),
+      tx_task_waiting_(false),
+      tx_producers_(0),
+      tx_parked_(),
+      tx_parked_count_(0),
+      rx_ring_(),
+#if WAVESHARE_CAN_RX_PRIORITY
+      rx_priority_ring_(),
+      rx_priority_ranges_(),
+      rx_priority_range_count_(0),
+      rx_borrowed_priority_(false),
+#endif
+#if WAVESHARE_CAN_SHARED_RX
+      frame_pool_(),
+      rx_subscribers_(),
+      rx_subscriber_count_(0),
+      rx_subscriber_drops_(),
+#endif  // WAVESHARE_CAN_SHARED_RX
+      rx_id_set_(),
+      rx_id_set_active_(false),
+#if WAVESHARE_CAN_FILTER_PROGRAM
+      rx_program_(),
+      rx_program_active_(false),
+#endif  // WAVESHARE_CAN_FILTER_PROGRAM
+#if WAVESHARE_CAN_RULES
+      rules_(),
+      rule_stats_(),
+      rule_count_(0),
+#endif  // WAVESHARE_CAN_RULES
+#if WAVESHARE_CAN_RTR_RESPONDER
+      rtr_responses_(),
+      rtr_response_count_(0),
+#endif  // WAVESHARE_CAN_RTR_RESPONDER
+#if WAVESHARE_CAN_LOW_LEVEL
+      ll_backend_(),
+      ll_isr_filter_(nullptr),
+      ll_isr_arg_(nullptr),
+      ll_intr_(nullptr),
+      ll_tx_done_(nullptr),
+      ll_tx_done_us_(0),
+#endif  // WAVESHARE_CAN_LOW_LEVEL
+      rate_limit_action_(kRateLimitReject),
+      bus_load_percent_(0),
+      bus_load_burst_frames_(0),
+      bus_bucket_(),
+      id_limits_(),
+      id_limits_active_(false),
+      tx_mailboxes_(),
+      tx_mailboxes_active_(false),
+#if WAVESHARE_CAN_TX_LATENCY
+      tx_latency_enabled_(false),
+      tx_in_flight_(),
+      tx_in_flight_head_(0),
+      tx_in_flight_count_(0),
+      tx_arb_lost_seen_(0),
+      tx_latency_used_(),
+      tx_latency_(),
+#endif  // WAVESHARE_CAN_TX_LATENCY
+#if WAVESHARE_CAN_ERROR_SAMPLER
+      error_sampler_(nullptr),
+      error_samples_(),
+      error_sample_count_(0),
+      error_sample_prev_(),
+#endif  // WAVESHARE_CAN_ERROR_SAMPLER
+      driver_tx_deadline_us_(0),
+      tx_handoff_seq_(0),
+      tx_handoffs_active_(0),
+      tx_purging_(false),
+      status_seq_(0),
+      status_cache_(),
+      status_cache_us_(0),
+      status_max_age_us_(0),
+      alert_mask_(kDefaultAlertMask),
+      alert_coalesce_us_(0),
+      pending_alerts_(0),
+      last_alert_delivery_us_(0),
+      alert_rate_bucket_(),
+      alert_log_bucket_{kAlertLogPerSec * 2000000ULL, kAlertLogPerSec * 2000000ULL,
+                        kAlertLogPerSec, 0},
+      alert_stats_(),
+      alert_stats_started_(false),
+      alert_stats_second_(0),
+      alert_stats_current_(0),
+      alert_stats_written_(0),
+#if WAVESHARE_CAN_RX_BATCHING
+      rx_batch_mode_(kRxBatchOff),
+      rx_batch_max_frames_(16),
+      rx_batch_max_delay_us_(1000),
+      rx_batch_rate_threshold_(2000),
+      rx_batching_(false),
+      rx_batch_(),
+      rx_batch_count_(0),
+      rx_batch_start_us_(0),
+      rx_window_frames_(0),
+      rx_window_start_us_(0),
+      rx_rate_avg_(0),
+#endif  // WAVESHARE_CAN_RX_BATCHING
       rx_dropped_count_(0),
-      tx_failed_count_(0) {
+#if WAVESHARE_CAN_RX_PRIORITY
+      rx_priority_dropped_count_(0),
+#endif
+      rx_id_rejected_count_(0),
+#if WAVESHARE_CAN_FILTER_PROGRAM
+      rx_program_rejected_count_(0),
+#endif
+#if WAVESHARE_CAN_RTR_RESPONDER
+      rtr_answered_count_(0),
+      rtr_failed_count_(0),
+#endif
+      tx_failed_count_(0),
+      tx_throttled_count_(0),
+      tx_expired_count_(0),
+      tx_late_count_(0),
+      tx_overwritten_count_(0),
+      rx_stack_low_(false),
+      rx_queue_high_water_(0),
+      tx_queue_high_water_(0),
+      rx_cb_max_us_(0),
+      rx_cb_calls_(0),
+      rx_cb_total_us_(0),
+      alert_cb_max_us_(0),
+      alert_cb_calls_(0),
+      alert_cb_total_us_(0),
+      callback_budget_us_(1000),
+      rx_cb_overruns_(0),
+      alert_cb_overruns_(0),
+      rx_progress_(0),
+      rx_watchdog_ms_(0),
+      watchdog_last_progress_(0),
+      watchdog_last_change_us_(0),
+      rx_stalled_(false),
+      rx_stall_count_(0) {
   timing_config_ = kCan500Kbps;
   filter_config_ = TWAI_FILTER_CONFIG_ACCEPT_ALL();
 }
 
 WaveshareCan::~WaveshareCan() {
+#if WAVESHARE_CAN_ERROR_SAMPLER
+  StopErrorSampler();
+#endif
+  DisableTxQueue();
   DisableRxInterrupt();
   DisableAlertInterrupt();
   End();
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (ll_tx_done_ != nullptr) vSemaphoreDelete(ll_tx_done_);
+#endif
 }
 
 bool WaveshareCan::Begin(twai_timing_config_t speed_config) {
   // Re-init safety: Clean up existing state if already initialized
   if (initialized_) {
-    Serial.println("Begin() called while already initialized - cleaning up first");
+    CanLog::Println("Begin() called while already initialized - cleaning up first");
     End();
   }
 
   timing_config_ = speed_config;
+  if (bus_load_percent_ > 0) {
+    // Bitrate may have changed - rescale the bus budget
+    SetBusLoadBudget(bus_load_percent_, bus_load_burst_frames_);
+  }
 
   twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(
       static_cast<gpio_num_t>(tx_pin_), static_cast<gpio_num_t>(rx_pin_),
       listen_only_ ? TWAI_MODE_LISTEN_ONLY : TWAI_MODE_NORMAL);
-  g_config.rx_queue_len = 32;
+  g_config.tx_queue_len = kDriverTxQueueLen;
+  g_config.rx_queue_len = kDriverRxQueueLen;
+#if defined(WAVESHARE_CAN_IRAM_HOT_PATH) && defined(CONFIG_TWAI_ISR_IN_IRAM)
+  // ISR keeps draining the controller FIFO while flash cache is off
+  g_config.intr_flags |= ESP_INTR_FLAG_IRAM;
+#endif
 
   if (twai_driver_install(&g_config, &speed_config, &filter_config_) != ESP_OK) {
-    Serial.println("TWAI driver install failed");
+    CanLog::Println("TWAI driver install failed");
     return false;
   }
 
   if (twai_start() != ESP_OK) {
-    Serial.println("TWAI start failed");
+    CanLog::Println("TWAI start failed");
     twai_driver_uninstall();
     return false;
   }
 
-  uint32_t alerts_to_enable =
-      TWAI_ALERT_RX_DATA | TWAI_ALERT_TX_IDLE | TWAI_ALERT_TX_SUCCESS |
-      TWAI_ALERT_TX_FAILED | TWAI_ALERT_ERR_PASS | TWAI_ALERT_BUS_ERROR |
-      TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED;
-
-  if (twai_reconfigure_alerts(alerts_to_enable, nullptr) != ESP_OK) {
-    Serial.println("Alerts reconfigure failed");
+  if (twai_reconfigure_alerts(EnabledAlerts(), nullptr) != ESP_OK) {
+    CanLog::Println("Alerts reconfigure failed");
     twai_stop();
     twai_driver_uninstall();
     return false;
   }
 
   initialized_ = true;
-  Serial.printf("CAN started - RX:%d TX:%d - %s mode\n", rx_pin_, tx_pin_,
+  low_level_ = false;
+  CanLog::Printf("CAN started - RX:%d TX:%d - %s mode\n", rx_pin_, tx_pin_,
            listen_only_ ? "listen-only" : "normal");
   return true;
 }
 
+#if WAVESHARE_CAN_LOW_LEVEL
+bool WaveshareCan::BeginLowLevel(twai_timing_config_t speed_config,
+                                 TwaiIsrFilter isr_filter, void* isr_arg) {
+  if (initialized_) {
+    CanLog::Println("BeginLowLevel() called while already initialized - cleaning up first");
+    End();
+  }
+
+  timing_config_ = speed_config;
+  if (bus_load_percent_ > 0) {
+    SetBusLoadBudget(bus_load_percent_, bus_load_burst_frames_);
+  }
+
+  if (ll_tx_done_ == nullptr) ll_tx_done_ = xSemaphoreCreateBinary();
+  if (ll_tx_done_ == nullptr) {
+    CanLog::Println("Failed to create TX semaphore");
+    return false;
+  }
+
+  if (!TwaiLowLevelAttach(tx_pin_, rx_pin_)) {
+    CanLog::Println("TWAI pin setup failed");
+    return false;
+  }
+
+  ll_isr_filter_ = isr_filter;
+  ll_isr_arg_ = isr_arg;
+  ll_backend_.Configure(speed_config, filter_config_, listen_only_);
+  ll_backend_.SetIsrFilter(isr_filter, isr_arg);
+
+#ifdef WAVESHARE_CAN_IRAM_HOT_PATH
+  const bool iram_isr = true;
+#else
+  const bool iram_isr = false;
+#endif
+  if (TwaiLowLevelInstallIsr(LowLevelIsr, this, iram_isr, &ll_intr_) != ESP_OK) {
+    CanLog::Println("TWAI interrupt allocation failed");
+    TwaiLowLevelDetach();
+    return false;
+  }
+
+  ll_backend_.Start();
+  low_level_ = true;
+  initialized_ = true;
+  CanLog::Printf("CAN started (register backend) - RX:%d TX:%d - %s mode\n",
+                rx_pin_, tx_pin_, listen_only_ ? "listen-only" : "normal");
+  return true;
+}
+#endif  // WAVESHARE_CAN_LOW_LEVEL
+
+bool WaveshareCan::Restart() {
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (low_level_) {
+    return BeginLowLevel(timing_config_, ll_isr_filter_, ll_isr_arg_);
+  }
+#endif
+  return Begin(timing_config_);
+}
+
+#if WAVESHARE_CAN_LOW_LEVEL
+void IRAM_ATTR WaveshareCan::LowLevelIsr(void* arg) {
+  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
+  BaseType_t woken = pdFALSE;
+  TaskHandle_t rx_task = instance->rx_task_handle_;
+  uint32_t events = instance->ll_backend_.ServiceInterrupt();
+  if ((events & kTwaiEventRx) && rx_task != nullptr) {
+    vTaskNotifyGiveFromISR(rx_task, &woken);
+  }
+  // No alert task on this backend - recover right here
+  if (events & kTwaiEventBusOff) instance->ll_backend_.StartRecovery();
+  if (events & kTwaiEventTxDone) {
+    portENTER_CRITICAL_ISR(&instance->ll_tx_lock_);
+    instance->ll_tx_done_us_ = esp_timer_get_time();
+    portEXIT_CRITICAL_ISR(&instance->ll_tx_lock_);
+    xSemaphoreGiveFromISR(instance->ll_tx_done_, &woken);
+  }
+  portYIELD_FROM_ISR(woken);
+}
+#endif  // WAVESHARE_CAN_LOW_LEVEL
+
+esp_err_t WAVESHARE_CAN_HOT WaveshareCan::ReceiveFromController(
+    twai_message_t* message, TickType_t wait) {
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (!low_level_) return twai_receive(message, wait);
+
+  if (ll_backend_.Receive(message)) return ESP_OK;
+  if (wait == 0) return ESP_ERR_TIMEOUT;
+  // The ISR notifies the RX task; other callers just poll after the wait
+  if (xTaskGetCurrentTaskHandle() == rx_task_handle_) {
+    ulTaskNotifyTake(pdTRUE, wait);
+  } else {
+    vTaskDelay(wait);
+  }
+  return ll_backend_.Receive(message) ? ESP_OK : ESP_ERR_TIMEOUT;
+#else
+  return twai_receive(message, wait);
+#endif
+}
+
+esp_err_t WAVESHARE_CAN_HOT WaveshareCan::TransmitToController(
+    const twai_message_t& message, TickType_t timeout) {
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (!low_level_) return twai_transmit(&message, timeout);
+
+  // Single TX buffer - wait for the TX interrupt to release it. A give left
+  // over from an earlier frame only costs one extra attempt.
+  const TickType_t start = xTaskGetTickCount();
+  while (true) {
+#if WAVESHARE_CAN_TX_LATENCY
+    TrackLowLevelTx();  // Retire the previous frame before loading the next
+#endif
+    portENTER_CRITICAL(&ll_tx_lock_);
+    bool loaded = ll_backend_.Transmit(message);
+    portEXIT_CRITICAL(&ll_tx_lock_);
+    if (loaded) return ESP_OK;
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= timeout) return ESP_ERR_TIMEOUT;
+    xSemaphoreTake(ll_tx_done_, timeout - elapsed);
+  }
+#else
+  return twai_transmit(&message, timeout);
+#endif
+}
+
+esp_err_t WaveshareCan::ClearControllerTx() {
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (low_level_) {
+    portENTER_CRITICAL(&ll_tx_lock_);
+    ll_backend_.AbortTx();
+    portEXIT_CRITICAL(&ll_tx_lock_);
+    return ESP_OK;
+  }
+#endif
+  return twai_clear_transmit_queue();
+}
+
 void WaveshareCan::End() {
   if (!initialized_) return;
 
@@ -78,21 +369,41 @@ void WaveshareCan::End() {
   shutdown_ = true;
   
   // Stop interrupt tasks BEFORE driver shutdown
+  DisableTxQueue();
   DisableRxInterrupt();
   DisableAlertInterrupt();
   
   // Now safe to stop TWAI driver
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (low_level_) {
+    ll_backend_.Stop();
+    esp_intr_free(ll_intr_);
+    ll_intr_ = nullptr;
+    TwaiLowLevelDetach();
+  } else {
+    twai_stop();
+    twai_driver_uninstall();
+  }
+#else
   twai_stop();
   twai_driver_uninstall();
+#endif
   
   initialized_ = false;
   shutdown_ = false;  // Reset for next Begin()
+
+  // Drop the cached snapshot - it describes the old driver instance
+  portENTER_CRITICAL(&status_cache_lock_);
+  status_seq_.fetch_add(1, std::memory_order_relaxed);
+  status_cache_us_ = 0;
+  status_seq_.fetch_add(1, std::memory_order_release);
+  portEXIT_CRITICAL(&status_cache_lock_);
 }
 
 int WaveshareCan::Available() {
   if (!initialized_) return 0;
   twai_status_info_t status;
-  if (twai_get_status_info(&status) != ESP_OK) return 0;
+  if (!ReadStatus(&status, status_max_age_us_)) return 0;
   return status.msgs_to_rx;
 }
 
@@ -111,356 +422,1977 @@ bool WaveshareCan::SendMessage(uint32_t id, bool extended, uint8_t* data,
     memcpy(message.data, data, length);
   }
 
-  esp_err_t res = twai_transmit(&message, pdMS_TO_TICKS(1000));
-  if (res != ESP_OK) {
-    tx_failed_count_++;
-    Serial.printf("TX failed: error 0x%X\n", res);
-  }
-  return (res == ESP_OK);
+  TxItem item = {message, 0, -1, esp_timer_get_time()};
+  return SubmitFrame(item, pdMS_TO_TICKS(1000));
 }
 
 bool WaveshareCan::SendMessage(uint32_t id, uint8_t* data, uint8_t length) {
   return SendMessage(id, false, data, length, false);
 }
 
-int WaveshareCan::ReceiveMessage(uint32_t* id, bool* extended, uint8_t* data,
-                                 uint8_t* length, bool* rtr) {
-  if (!initialized_) return -1;
+bool WaveshareCan::SendFrame(const CanFrame& frame, uint32_t timeout_ms) {
+  if (!initialized_ || listen_only_) return false;
 
-  twai_message_t message;
-  if (twai_receive(&message, 0) != ESP_OK) return -1;
+  TxItem item;
+  BuildMessage(frame, &item.message);
+  item.deadline_us = AbsoluteDeadline(frame.deadline_us);
+  item.mailbox = -1;
+  item.enqueue_us = esp_timer_get_time();
+  return SubmitFrame(item, pdMS_TO_TICKS(timeout_ms));
+}
 
-  if (id) *id = message.identifier;
-  if (extended) *extended = message.extd;
-  if (length) *length = message.data_length_code;
-  if (rtr) *rtr = message.rtr;
+CanTxHandle WaveshareCan::MakeTxHandle(uint32_t id, bool extended,
+                                       uint8_t length, bool rtr,
+                                       bool single_shot) {
+  CanFrame frame = {};
+  frame.id = id;
+  frame.extended = extended;
+  frame.rtr = rtr;
+  frame.length = length;
+  frame.single_shot = single_shot;
+  return MakeTxHandle(frame);
+}
 
-  if (!message.rtr && data) {
-    memcpy(data, message.data, message.data_length_code);
+CanTxHandle WaveshareCan::MakeTxHandle(const CanFrame& frame) {
+  CanTxHandle handle;
+  BuildMessage(frame, &handle.message);
+  handle.deadline_us = frame.deadline_us;
+  return handle;
+}
+
+bool WAVESHARE_CAN_HOT WaveshareCan::Send(const CanTxHandle& handle,
+                                          uint32_t timeout_ms) {
+  if (!initialized_ || listen_only_) return false;
+
+  TxItem item;
+  item.message = handle.message;
+  item.deadline_us = AbsoluteDeadline(handle.deadline_us);
+  item.mailbox = -1;
+  item.enqueue_us = esp_timer_get_time();
+  return SubmitFrame(item, pdMS_TO_TICKS(timeout_ms));
+}
+
+size_t WaveshareCan::SendBatch(const CanFrame* frames, size_t count,
+                               uint32_t timeout_ms) {
+  if (!initialized_ || listen_only_ || frames == nullptr) return 0;
+
+  // twai_transmit() blocks on the driver's TX slot semaphore, which the TWAI
+  // ISR gives back on every TX_SUCCESS and refills the controller from the
+  // driver queue - so frames go out back-to-back while we keep it topped up.
+  const TickType_t start = xTaskGetTickCount();
+  const TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+  size_t sent = 0;
+
+  while (sent < count) {
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    TickType_t remaining = (elapsed < timeout) ? (timeout - elapsed) : 0;
+
+    TxItem item;
+    BuildMessage(frames[sent], &item.message);
+    item.deadline_us = AbsoluteDeadline(frames[sent].deadline_us);
+    item.mailbox = -1;
+    item.enqueue_us = esp_timer_get_time();
+
+    if (!SubmitFrame(item, remaining)) break;
+    sent++;
   }
 
-  return message.data_length_code;
+  return sent;
 }
 
-bool WaveshareCan::Filter(uint32_t id, uint32_t mask, bool extended) {
-  if (!initialized_) return false;
+bool WAVESHARE_CAN_HOT WaveshareCan::SubmitFrame(const TxItem& item,
+                                                 TickType_t timeout,
+                                                 bool quiet) {
+  // Register before looking at the flag (both seq_cst) - DisableTxQueue()
+  // clears the flag first and then waits for tx_producers_ to drain
+  tx_producers_.fetch_add(1);
+  if (tx_queue_enabled_.load()) {
+    bool queued = SubmitToQueue(item, timeout);
+    tx_producers_.fetch_sub(1);
+    return queued;
+  }
+  tx_producers_.fetch_sub(1);
 
-  End();
-  
-  if (extended) {
-    // Extended 29-bit IDs: use bits as-is
-    filter_config_.acceptance_code = (id << 3);
-    filter_config_.acceptance_mask = ~(mask << 3);
-  } else {
-    // Standard 11-bit IDs: shift to upper bits of 29-bit field
-    filter_config_.acceptance_code = (id << 21);
-    filter_config_.acceptance_mask = ~(mask << 21);
+  TickType_t token_wait = (rate_limit_action_ == kRateLimitQueue) ? timeout : 0;
+  if (!AcquireTxTokens(item.message, token_wait)) return false;
+
+  // HandOffToDriver() already counted the failure - quiet only skips the log
+  esp_err_t res = HandOffToDriver(item, timeout);
+  if (res != ESP_OK && !quiet && item.deadline_us == 0) {
+    // Deadline frames expire silently - see GetTxExpiredCount()
+    CanLog::Printf("TX failed: error 0x%X\n", res);
   }
-  
-  filter_config_.single_filter = true;
-  return Begin(timing_config_);
+  return (res == ESP_OK);
 }
 
-bool WaveshareCan::GetStatus(twai_status_info_t* status) {
-  if (!initialized_ || !status) return false;
-  return (twai_get_status_info(status) == ESP_OK);
-}
+bool WAVESHARE_CAN_HOT WaveshareCan::SubmitToQueue(const TxItem& item,
+                                                   TickType_t timeout) {
+  int16_t mailbox = -1;
+  if (tx_mailboxes_active_) {
+    uint32_t key = item.message.identifier |
+                   (item.message.extd ? kExtendedKeyFlag : 0);
+    portENTER_CRITICAL(&tx_limit_lock_);
+    mailbox = FindTxMailbox(key, false);
+    if (mailbox >= 0 && tx_mailboxes_[mailbox].pending) {
+      // Still waiting in the queue - replace it with the fresh value
+      tx_mailboxes_[mailbox].item = item;
+      tx_mailboxes_[mailbox].item.mailbox = mailbox;
+      portEXIT_CRITICAL(&tx_limit_lock_);
+      CanStats::Add(tx_overwritten_count_);
+      return true;
+    }
+    portEXIT_CRITICAL(&tx_limit_lock_);
+  }
 
-bool WaveshareCan::SetListenOnly(bool listen_only) {
-  if (initialized_ && listen_only_ != listen_only) {
-    End();
-    listen_only_ = listen_only;
-    return Begin(timing_config_);
+  // Reject mode charges tokens at enqueue so the caller sees the verdict;
+  // queue mode charges them in TxTask() right before transmission.
+  if (rate_limit_action_ == kRateLimitReject &&
+      !AcquireTxTokens(item.message, 0)) {
+    return false;
   }
-  listen_only_ = listen_only;
-  return true;
-}
 
-bool WaveshareCan::ProcessAlerts(uint32_t* alerts_triggered) {
-  if (!initialized_) return false;
+  if (mailbox < 0) {
+    if (!EnqueueTx(item, timeout)) {
+      CanStats::Add(tx_failed_count_);
+      return false;
+    }
+    return true;
+  }
 
-  uint32_t alerts = 0;
-  if (twai_read_alerts(&alerts, pdMS_TO_TICKS(0)) != ESP_OK) return false;
-  if (alerts == 0) return false;
+  // Park the frame in its mailbox and queue a reference to the slot
+  TxItem ref = item;
+  ref.mailbox = mailbox;
+  portENTER_CRITICAL(&tx_limit_lock_);
+  tx_mailboxes_[mailbox].item = ref;
+  tx_mailboxes_[mailbox].pending = true;
+  portEXIT_CRITICAL(&tx_limit_lock_);
+
+  if (!EnqueueTx(ref, timeout)) {
+    portENTER_CRITICAL(&tx_limit_lock_);
+    tx_mailboxes_[mailbox].pending = false;
+    portEXIT_CRITICAL(&tx_limit_lock_);
+    CanStats::Add(tx_failed_count_);
+    return false;
+  }
+  return true;
+}
 
-  if (alerts_triggered) *alerts_triggered = alerts;
+bool WAVESHARE_CAN_HOT WaveshareCan::EnqueueTx(const TxItem& item,
+                                               TickType_t timeout) {
+  // Producers only contend on one CAS - nobody holds a lock while waiting
+  const TickType_t start = xTaskGetTickCount();
+  while (!tx_queue_.Push(item)) {
+    if (xTaskGetTickCount() - start >= timeout || !tx_queue_enabled_) {
+      return false;
+    }
+    vTaskDelay(1);  // Full - only the TX task can make room
+  }
 
-  HandleAlerts(alerts);
-  if (alert_callback_) alert_callback_(alerts);
+  uint32_t depth = tx_queue_.Size();
+  if (depth > tx_queue_high_water_) tx_queue_high_water_ = depth;
 
+  if (tx_task_waiting_.exchange(false)) xTaskNotifyGive(tx_task_handle_);
   return true;
 }
 
-void WaveshareCan::OnAlert(void (*callback)(uint32_t)) {
-  alert_callback_ = callback;
-}
+esp_err_t WAVESHARE_CAN_HOT WaveshareCan::HandOffToDriver(const TxItem& item,
+                                                         TickType_t timeout) {
+  if (item.deadline_us != 0) {
+    int64_t now = esp_timer_get_time();
+    if (now >= item.deadline_us) {
+      CanStats::Add(tx_expired_count_);
+      return ESP_ERR_TIMEOUT;
+    }
+    // Never wait for a TX slot beyond the frame's deadline
+    TickType_t left = pdMS_TO_TICKS((item.deadline_us - now) / 1000);
+    if (left < timeout) timeout = left;
+  }
 
-void WaveshareCan::HandleAlerts(uint32_t alerts) {
-  twai_status_info_t status;
-  twai_get_status_info(&status);
+  PurgeExpiredDriverTx();
 
-  if (alerts & TWAI_ALERT_BUS_OFF) {
-    Serial.println("BUS-OFF -> trying recovery");
-    twai_initiate_recovery();
-  }
-  if (alerts & TWAI_ALERT_BUS_RECOVERED) {
-    Serial.println("Bus recovered");
-  }
-  if (alerts & TWAI_ALERT_ERR_PASS) {
-    Serial.println("Error passive state");
+  // Mark the driver queue before the frame can enter it, so a purge that
+  // runs concurrently never flushes it. Wait out a flush in progress.
+  while (true) {
+    portENTER_CRITICAL(&tx_limit_lock_);
+    if (!tx_purging_) break;
+    portEXIT_CRITICAL(&tx_limit_lock_);
+    taskYIELD();
   }
-  if (alerts & TWAI_ALERT_BUS_ERROR) {
-    Serial.printf("Bus error - count: %d", status.bus_error_count);
+  tx_handoff_seq_++;
+  tx_handoffs_active_++;
+  if (item.deadline_us == 0) {
+    driver_tx_deadline_us_ = -1;
+  } else if (driver_tx_deadline_us_ >= 0 &&
+             item.deadline_us > driver_tx_deadline_us_) {
+    driver_tx_deadline_us_ = item.deadline_us;
   }
-  if (alerts & TWAI_ALERT_RX_QUEUE_FULL) {
-    Serial.printf("RX queue full - buffered:%d missed:%d overrun:%d",
-             status.msgs_to_rx, status.rx_missed_count, status.rx_overrun_count);
+  portEXIT_CRITICAL(&tx_limit_lock_);
+
+  esp_err_t res = TransmitToController(item.message, timeout);
+
+  portENTER_CRITICAL(&tx_limit_lock_);
+  tx_handoffs_active_--;
+  portEXIT_CRITICAL(&tx_limit_lock_);
+#if WAVESHARE_CAN_TX_LATENCY
+  if (res == ESP_OK && tx_latency_enabled_) {
+    // Driver sends in FIFO order, so TX alerts retire records oldest-first
+    TxInFlight record = {
+        item.message.identifier | (item.message.extd ? kExtendedKeyFlag : 0),
+        item.enqueue_us, esp_timer_get_time()};
+    portENTER_CRITICAL(&tx_stats_lock_);
+    if (tx_in_flight_count_ == kTxInFlightSlots) {
+      // Alerts not being processed - drop the oldest record
+      tx_in_flight_head_ = (tx_in_flight_head_ + 1) % kTxInFlightSlots;
+      tx_in_flight_count_--;
+    }
+    tx_in_flight_[(tx_in_flight_head_ + tx_in_flight_count_) % kTxInFlightSlots] =
+        record;
+    tx_in_flight_count_++;
+    portEXIT_CRITICAL(&tx_stats_lock_);
   }
-  if (alerts & TWAI_ALERT_TX_FAILED) {
-    Serial.printf("TX failed - buffered:%d errors:%d failed:%d",
-             status.msgs_to_tx, status.tx_error_counter, status.tx_failed_count);
+#endif
+
+  if (res == ESP_OK) return res;
+  // A failed frame leaves its mark - that only delays the next purge
+  if (item.deadline_us != 0 && esp_timer_get_time() >= item.deadline_us) {
+    CanStats::Add(tx_expired_count_);
+  } else {
+    CanStats::Add(tx_failed_count_);
   }
+  return res;
 }
 
-bool WaveshareCan::EnableAlertInterrupt(void (*callback)(uint32_t)) {
-  if (!initialized_) {
-    Serial.println("Cannot enable alert interrupt: CAN not initialized");
-    return false;
-  }
+void WAVESHARE_CAN_HOT WaveshareCan::PurgeExpiredDriverTx() {
+  if (driver_tx_deadline_us_ == 0) return;  // Unlocked peek, rechecked below
 
-  if (alert_interrupt_enabled_) {
-    Serial.println("Alert interrupt already enabled");
-    return true;
-  }
+  portENTER_CRITICAL(&tx_limit_lock_);
+  uint32_t seq = tx_handoff_seq_;
+  portEXIT_CRITICAL(&tx_limit_lock_);
 
-  if (callback) {
-    alert_callback_ = callback;
+  twai_status_info_t status;
+  if (!FetchStatus(&status)) return;
+
+  // The status is only valid if no hand-off ran or started since it was
+  // read - otherwise retry on the next call
+  portENTER_CRITICAL(&tx_limit_lock_);
+  int64_t deadline = driver_tx_deadline_us_;
+  if (seq != tx_handoff_seq_ || tx_handoffs_active_ > 0 || deadline == 0) {
+    portEXIT_CRITICAL(&tx_limit_lock_);
+    return;
   }
+  if (status.msgs_to_tx == 0) {
+    // Driver drained - forget deadlines of frames already sent
+    driver_tx_deadline_us_ = 0;
+    portEXIT_CRITICAL(&tx_limit_lock_);
+    return;
+  }
+  // The driver queue can only be flushed as a whole, so do it only when
+  // every frame in it carries a deadline and the latest one has passed.
+  if (deadline < 0 || esp_timer_get_time() < deadline) {
+    portEXIT_CRITICAL(&tx_limit_lock_);
+    return;
+  }
+  tx_purging_ = true;  // Holds off new hand-offs until the flush is done
+  portEXIT_CRITICAL(&tx_limit_lock_);
 
-  // CRITICAL: Set flag BEFORE creating task to avoid race condition
-  alert_interrupt_enabled_ = true;
-
-  BaseType_t result = xTaskCreate(
-      AlertTaskWrapper,
-      "can_alert_task",
-      kAlertTaskStackSize,  // Already in words
-      this,
-      4,
-      &alert_task_handle_);
+  esp_err_t res = ClearControllerTx();
 
-  if (result != pdPASS) {
-    Serial.println("Failed to create alert task");
-    alert_task_handle_ = nullptr;
-    alert_interrupt_enabled_ = false;  // Rollback
-    return false;
-  }
+  portENTER_CRITICAL(&tx_limit_lock_);
+  if (res == ESP_OK) driver_tx_deadline_us_ = 0;
+  tx_purging_ = false;
+  portEXIT_CRITICAL(&tx_limit_lock_);
 
-  Serial.println("Alert interrupt enabled");
-  return true;
+  // Every frame counted here was marked with a deadline that has passed
+  if (res == ESP_OK) CanStats::Add(tx_late_count_, status.msgs_to_tx);
 }
 
-void WaveshareCan::DisableAlertInterrupt() {
-  if (!alert_interrupt_enabled_) return;
+bool WAVESHARE_CAN_HOT WaveshareCan::AcquireTxTokens(
+    const twai_message_t& message, TickType_t max_wait, bool count_throttled) {
+  if (bus_load_percent_ == 0 && !id_limits_active_) return true;
 
-  alert_interrupt_enabled_ = false;
+  uint32_t bits = FrameBits(message.extd, message.data_length_code, message.rtr);
+  uint32_t key = message.identifier | (message.extd ? kExtendedKeyFlag : 0);
+  TickType_t start = xTaskGetTickCount();
+  bool counted = !count_throttled;
 
-  // Wait for task to self-delete
-  if (alert_task_handle_ != nullptr) {
-    uint32_t wait_count = 0;
-    while (alert_task_handle_ != nullptr && wait_count < 50) {  // Max 500ms
-      vTaskDelay(pdMS_TO_TICKS(10));
-      wait_count++;
+  while (true) {
+    int64_t now = esp_timer_get_time();
+    int64_t wait_us;
+
+    portENTER_CRITICAL(&tx_limit_lock_);
+    IdRateLimit* limit = id_limits_active_ ? FindIdRateLimit(key, false) : nullptr;
+    TokenBucket* id_bucket = (limit && limit->bucket.rate) ? &limit->bucket : nullptr;
+
+    wait_us = BucketWaitUs(&bus_bucket_, bits, now);
+    if (id_bucket) {
+      int64_t id_wait = BucketWaitUs(id_bucket, 1, now);
+      if (id_wait > wait_us) wait_us = id_wait;
     }
-    
-    if (alert_task_handle_ != nullptr) {
-      Serial.println("WARNING: Alert task did not exit cleanly");
-      alert_task_handle_ = nullptr;
+    if (wait_us == 0) {
+      // Both buckets have room - charge them together
+      if (bus_bucket_.rate) bus_bucket_.tokens -= static_cast<uint64_t>(bits) * 1000000;
+      if (id_bucket) id_bucket->tokens -= 1000000;
     }
-  }
+    portEXIT_CRITICAL(&tx_limit_lock_);
 
-  Serial.println("Alert interrupt disabled");
-}
+    if (wait_us == 0) return true;
 
-void WaveshareCan::AlertTaskWrapper(void* arg) {
-  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
-  instance->AlertTask();
+    if (!counted) {
+      CanStats::Add(tx_throttled_count_);
+      counted = true;
+    }
+
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    if (elapsed >= max_wait || shutdown_) return false;
+
+    // Sleep until the bucket refills, in short slices for clean shutdown
+    TickType_t sleep = pdMS_TO_TICKS(wait_us / 1000 + 1);
+    TickType_t remaining = max_wait - elapsed;
+    if (sleep > remaining) sleep = remaining;
+    if (sleep > pdMS_TO_TICKS(10)) sleep = pdMS_TO_TICKS(10);
+    vTaskDelay(sleep > 0 ? sleep : 1);
+  }
 }
 
-void WaveshareCan::AlertTask() {
-  // Note: No Serial - causes stack overflow
-  uint32_t alerts = 0;
-  uint32_t check_counter = 0;
+bool WAVESHARE_CAN_HOT WaveshareCan::IdTokensReady(uint32_t key) {
+  portENTER_CRITICAL(&tx_limit_lock_);
+  IdRateLimit* limit = FindIdRateLimit(key, false);
+  bool ready = (limit == nullptr || limit->bucket.rate == 0 ||
+                BucketWaitUs(&limit->bucket, 1, esp_timer_get_time()) == 0);
+  portEXIT_CRITICAL(&tx_limit_lock_);
+  return ready;
+}
 
-  while (alert_interrupt_enabled_ && initialized_ && !shutdown_) {
-    esp_err_t err = twai_read_alerts(&alerts, pdMS_TO_TICKS(100));
-    
-    if (err == ESP_OK && alerts != 0) {
-      // Only call user callback - NO HandleAlerts (has Serial.printf)
-      if (alert_callback_) {
-        alert_callback_(alerts);
+bool WAVESHARE_CAN_HOT WaveshareCan::ParkIfIdLimited(const TxItem& item) {
+  uint32_t key = item.message.identifier |
+                 (item.message.extd ? kExtendedKeyFlag : 0);
+  while (true) {
+    // Frames of an ID with a parked frame line up behind it to keep order
+    bool behind_parked = false;
+    for (size_t i = 0; i < tx_parked_count_; i++) {
+      const twai_message_t& parked = tx_parked_[i].message;
+      if ((parked.identifier | (parked.extd ? kExtendedKeyFlag : 0)) == key) {
+        behind_parked = true;
+        break;
       }
-    } else if (err == ESP_ERR_TIMEOUT) {
-      vTaskDelay(pdMS_TO_TICKS(1));
     }
+    if (!behind_parked && IdTokensReady(key)) return false;
 
-    // Periodic stack monitoring (no Serial)
-    if (++check_counter % 1000 == 0) {
-      uint32_t free_stack = uxTaskGetStackHighWaterMark(NULL);
-      (void)free_stack;  // Suppress unused warning
+    if (tx_parked_count_ < kTxParkSlots) {
+      tx_parked_[tx_parked_count_++] = item;
+      CanStats::Add(tx_throttled_count_);
+      return true;
     }
+
+    // All slots taken - wait for one to free (dropped on shutdown, like
+    // the rest of the queue)
+    if (!tx_queue_enabled_ || shutdown_) return true;
+    vTaskDelay(1);
+    ServiceParkedTx();
   }
-  
-  // Task exits cleanly - self-delete
-  alert_task_handle_ = nullptr;
-  vTaskDelete(NULL);
 }
 
-void WaveshareCan::OnReceive(void (*callback)(const twai_message_t& msg)) {
-  rx_callback_ = callback;
+void WAVESHARE_CAN_HOT WaveshareCan::ServiceParkedTx() {
+  int64_t now = esp_timer_get_time();
+  size_t kept = 0;
+  for (size_t i = 0; i < tx_parked_count_; i++) {
+    TxItem item = tx_parked_[i];
+    uint32_t key = item.message.identifier |
+                   (item.message.extd ? kExtendedKeyFlag : 0);
+
+    // An older frame of the same ID still waiting goes first
+    bool blocked = false;
+    for (size_t j = 0; j < kept && !blocked; j++) {
+      const twai_message_t& older = tx_parked_[j].message;
+      blocked = (older.identifier | (older.extd ? kExtendedKeyFlag : 0)) == key;
+    }
+
+    if (!blocked) {
+      if (item.deadline_us != 0 && now >= item.deadline_us) {
+        CanStats::Add(tx_expired_count_);
+        continue;
+      }
+      if (AcquireTxTokens(item.message, 0, false)) {
+        HandOffToDriver(item, pdMS_TO_TICKS(1000));
+        continue;
+      }
+    }
+    tx_parked_[kept++] = item;
+  }
+  tx_parked_count_ = kept;
 }
 
-bool WaveshareCan::EnableRxInterrupt(void (*callback)(const twai_message_t& msg)) {
-  if (!initialized_) {
-    Serial.println("Cannot enable RX interrupt: CAN not initialized");
-    return false;
+void WaveshareCan::ConfigureBucket(TokenBucket* bucket, uint32_t rate,
+                                   uint32_t burst) {
+  bucket->rate = rate;
+  bucket->capacity = static_cast<uint64_t>(burst) * 1000000;
+  bucket->tokens = bucket->capacity;  // Start full
+  bucket->last_us = esp_timer_get_time();
+}
+
+int64_t WAVESHARE_CAN_HOT WaveshareCan::BucketWaitUs(TokenBucket* bucket,
+                                                     uint32_t cost,
+                                                     int64_t now_us) {
+  if (bucket->rate == 0) return 0;
+
+  // Refill for the time elapsed since the last check
+  int64_t elapsed = now_us - bucket->last_us;
+  if (elapsed > 0) {
+    uint64_t refill = static_cast<uint64_t>(elapsed) * bucket->rate;
+    bucket->tokens = (bucket->capacity - bucket->tokens > refill)
+                         ? bucket->tokens + refill
+                         : bucket->capacity;
+    bucket->last_us = now_us;
   }
 
-  if (rx_interrupt_enabled_) {
-    Serial.println("RX interrupt already enabled");
-    return true;
+  uint64_t needed = static_cast<uint64_t>(cost) * 1000000;
+  if (bucket->tokens >= needed) return 0;
+  return static_cast<int64_t>((needed - bucket->tokens) / bucket->rate) + 1;
+}
+
+WaveshareCan::IdRateLimit* WAVESHARE_CAN_HOT WaveshareCan::FindIdRateLimit(
+    uint32_t key, bool insert) {
+  // Open addressing, linear probe - O(1) for a sparsely filled table
+  size_t index = (key * 2654435761u) & (kMaxIdRateLimits - 1);
+  for (size_t i = 0; i < kMaxIdRateLimits; i++) {
+    IdRateLimit* slot = &id_limits_[(index + i) & (kMaxIdRateLimits - 1)];
+    if (slot->used && slot->key == key) return slot;
+    if (!slot->used) {
+      if (!insert) return nullptr;
+      slot->used = true;
+      slot->key = key;
+      return slot;
+    }
   }
+  return nullptr;
+}
 
-  if (callback) {
-    rx_callback_ = callback;
+int16_t WAVESHARE_CAN_HOT WaveshareCan::FindTxMailbox(uint32_t key, bool insert) {
+  // Same probing scheme as FindIdRateLimit()
+  size_t index = (key * 2654435761u) & (kMaxTxMailboxes - 1);
+  for (size_t i = 0; i < kMaxTxMailboxes; i++) {
+    size_t slot_index = (index + i) & (kMaxTxMailboxes - 1);
+    TxMailbox* slot = &tx_mailboxes_[slot_index];
+    if (slot->used && slot->key == key) return static_cast<int16_t>(slot_index);
+    if (!slot->used) {
+      if (!insert) return -1;
+      slot->used = true;
+      slot->pending = false;
+      slot->key = key;
+      return static_cast<int16_t>(slot_index);
+    }
   }
+  return -1;
+}
 
-  shutdown_ = false;
+bool WAVESHARE_CAN_HOT WaveshareCan::TakeTxMailbox(TxItem* item) {
+  // Swap the queued slot reference for the slot's current (freshest) frame
+  bool pending = false;
+  portENTER_CRITICAL(&tx_limit_lock_);
+  TxMailbox* slot = &tx_mailboxes_[item->mailbox];
+  if (slot->used && slot->pending) {
+    *item = slot->item;
+    slot->pending = false;
+    pending = true;
+  }
+  portEXIT_CRITICAL(&tx_limit_lock_);
+  return pending;
+}
 
-  rx_queue_ = xQueueCreate(16, sizeof(twai_message_t));
-  
-  if (rx_queue_ == nullptr) {
-    Serial.println("Failed to create RX queue");
-    return false;
+bool WaveshareCan::AddTxMailbox(uint32_t id, bool extended) {
+  uint32_t key = id | (extended ? kExtendedKeyFlag : 0);
+
+  portENTER_CRITICAL(&tx_limit_lock_);
+  int16_t mailbox = FindTxMailbox(key, true);
+  if (mailbox >= 0) tx_mailboxes_active_ = true;
+  portEXIT_CRITICAL(&tx_limit_lock_);
+
+  return mailbox >= 0;
+}
+
+void WaveshareCan::ClearTxMailboxes() {
+  portENTER_CRITICAL(&tx_limit_lock_);
+  tx_mailboxes_active_ = false;
+  for (size_t i = 0; i < kMaxTxMailboxes; i++) {
+    // Queued slot references now resolve to nothing in TakeTxMailbox()
+    tx_mailboxes_[i].used = false;
+    tx_mailboxes_[i].pending = false;
   }
+  portEXIT_CRITICAL(&tx_limit_lock_);
+}
 
-  rx_interrupt_enabled_ = true;
+void WaveshareCan::SetBusLoadBudget(uint8_t percent, uint16_t burst_frames) {
+  if (percent > 100) percent = 100;
+  if (burst_frames == 0) burst_frames = 1;
 
-  BaseType_t result = xTaskCreate(
-      RxTaskWrapper,
-      "can_rx_task",
-      kRxTaskStackSize,
-      this,
-      5,
-      &rx_task_handle_);
+  uint32_t rate = static_cast<uint32_t>(
+      static_cast<uint64_t>(GetBitrate()) * percent / 100);
+  uint32_t burst_bits = FrameBits(true, 8) * burst_frames;
 
-  if (result != pdPASS) {
-    Serial.println("Failed to create RX task");
-    vQueueDelete(rx_queue_);
-    rx_queue_ = nullptr;
-    rx_task_handle_ = nullptr;
-    rx_interrupt_enabled_ = false;
-    return false;
+  portENTER_CRITICAL(&tx_limit_lock_);
+  bus_load_percent_ = percent;
+  bus_load_burst_frames_ = burst_frames;
+  ConfigureBucket(&bus_bucket_, percent ? rate : 0, burst_bits);
+  portEXIT_CRITICAL(&tx_limit_lock_);
+}
+
+bool WaveshareCan::SetIdRateLimit(uint32_t id, bool extended,
+                                  uint32_t frames_per_sec, uint16_t burst) {
+  uint32_t key = id | (extended ? kExtendedKeyFlag : 0);
+  if (burst == 0) burst = 1;
+
+  portENTER_CRITICAL(&tx_limit_lock_);
+  // Removed limits keep their slot (rate 0) so probe chains stay intact
+  IdRateLimit* limit = FindIdRateLimit(key, frames_per_sec > 0);
+  if (limit) {
+    ConfigureBucket(&limit->bucket, frames_per_sec, burst);
+    id_limits_active_ = true;
   }
+  portEXIT_CRITICAL(&tx_limit_lock_);
 
-  Serial.println("RX interrupt enabled");
-  return true;
+  return limit != nullptr || frames_per_sec == 0;
 }
 
-void WaveshareCan::DisableRxInterrupt() {
-  if (!rx_interrupt_enabled_) return;
+void WaveshareCan::SetRateLimitAction(RateLimitAction action) {
+  rate_limit_action_ = action;
+}
 
-  rx_interrupt_enabled_ = false;
+uint32_t WaveshareCan::GetBitrate() const {
+  // TWAI source clock is APB (80 MHz); one bit = 1 + tseg_1 + tseg_2 quanta
+  uint32_t quanta = 1 + timing_config_.tseg_1 + timing_config_.tseg_2;
+  if (timing_config_.brp == 0 || quanta == 0) return 0;
+  return 80000000UL / (timing_config_.brp * quanta);
+}
 
-  // Wait for task to self-delete (checks flag every 100ms + processing time)
-  if (rx_task_handle_ != nullptr) {
-    // Task will see flag change and self-delete within ~200ms
-    uint32_t wait_count = 0;
+uint32_t WAVESHARE_CAN_HOT WaveshareCan::FrameBits(bool extended,
+                                                   uint8_t length, bool rtr) {
+  if (length > 8) length = 8;
+  uint32_t payload_bits = rtr ? 0 : 8u * length;
+
+  // Stuffable region: SOF..CRC (34 std / 54 ext bits + payload).
+  // Fixed part adds CRC delimiter, ACK, EOF and 3-bit intermission.
+  uint32_t stuffable = (extended ? 54 : 34) + payload_bits;
+  uint32_t stuff_bits = (stuffable - 1) / 4;
+  return stuffable + stuff_bits + 13;
+}
+
+void WaveshareCan::BuildMessage(const CanFrame& frame, twai_message_t* message) {
+  uint8_t length = frame.length > 8 ? 8 : frame.length;
+
+  *message = {};
+  message->identifier = frame.id;
+  message->extd = frame.extended;
+  message->rtr = frame.rtr;
+  message->data_length_code = length;
+  message->ss = frame.single_shot;
+  message->self = frame.self_rx;
+
+  if (!frame.rtr) {
+    memcpy(message->data, frame.data, length);
+  }
+}
+
+int64_t WaveshareCan::AbsoluteDeadline(uint32_t deadline_us) {
+  if (deadline_us == 0) return 0;
+  return esp_timer_get_time() + deadline_us;
+}
+
+int WaveshareCan::ReceiveMessage(uint32_t* id, bool* extended, uint8_t* data,
+                                 uint8_t* length, bool* rtr) {
+  if (!initialized_) return -1;
+
+  twai_message_t message;
+  if (ReceiveFromController(&message, 0) != ESP_OK) return -1;
+
+  if (id) *id = message.identifier;
+  if (extended) *extended = message.extd;
+  if (length) *length = message.data_length_code;
+  if (rtr) *rtr = message.rtr;
+
+  if (!message.rtr && data) {
+    memcpy(data, message.data, message.data_length_code);
+  }
+
+  return message.data_length_code;
+}
+
+bool WaveshareCan::Filter(uint32_t id, uint32_t mask, bool extended) {
+  if (!initialized_) return false;
+
+  End();
+  
+  if (extended) {
+    // Extended 29-bit IDs: use bits as-is
+    filter_config_.acceptance_code = (id << 3);
+    filter_config_.acceptance_mask = ~(mask << 3);
+  } else {
+    // Standard 11-bit IDs: shift to upper bits of 29-bit field
+    filter_config_.acceptance_code = (id << 21);
+    filter_config_.acceptance_mask = ~(mask << 21);
+  }
+  
+  filter_config_.single_filter = true;
+  return Restart();
+}
+
+bool WaveshareCan::Filter(const twai_filter_config_t& config) {
+  if (!initialized_) return false;
+
+  End();
+  filter_config_ = config;
+  return Restart();
+}
+
+void WaveshareCan::SetRxIdSet(const CanIdLookup& lookup) {
+  rx_id_set_active_ = false;
+  rx_id_set_ = lookup;
+  std::atomic_thread_fence(std::memory_order_release);
+  rx_id_set_active_ = (lookup.keys != nullptr);
+}
+
+void WaveshareCan::ClearRxIdSet() {
+  rx_id_set_active_ = false;
+}
+
+#if WAVESHARE_CAN_FILTER_PROGRAM
+bool WaveshareCan::SetRxFilterProgram(const char* expression) {
+  CanFilterProgram program;
+  if (!program.Compile(expression)) {
+    CanLog::Printf("RX filter error at %u: %s\n",
+                   static_cast<unsigned>(program.ErrorPos()), program.Error());
+    return false;
+  }
+  return SetRxFilterProgram(program);
+}
+
+bool WaveshareCan::SetRxFilterProgram(const CanFilterProgram& program) {
+  if (program.Empty()) return false;
+
+  rx_program_active_ = false;
+  rx_program_ = program;
+  std::atomic_thread_fence(std::memory_order_release);
+  rx_program_active_ = true;
+  return true;
+}
+
+void WaveshareCan::ClearRxFilterProgram() {
+  rx_program_active_ = false;
+}
+#endif  // WAVESHARE_CAN_FILTER_PROGRAM
+
+#if WAVESHARE_CAN_RULES
+int WaveshareCan::AddRule(const CanRule& rule) {
+  uint32_t count = rule_count_;
+  if (count >= kMaxRules) return -1;
+
+  if (rule.actions & CanRule::kActionGpio) {
+    if (!GPIO_IS_VALID_OUTPUT_GPIO(rule.gpio_pin)) return -1;
+    pinMode(rule.gpio_pin, OUTPUT);
+  }
+
+  rules_[count] = rule;
+  rule_stats_[count] = CanRuleStats();
+  // Entry complete before the RX task can see it
+  std::atomic_thread_fence(std::memory_order_release);
+  rule_count_ = count + 1;
+  return static_cast<int>(count);
+}
+
+void WaveshareCan::ClearRules() {
+  rule_count_ = 0;
+}
+
+bool WaveshareCan::GetRuleStats(int index, CanRuleStats* stats) const {
+  if (!stats || index < 0 || static_cast<uint32_t>(index) >= rule_count_) {
+    return false;
+  }
+  *stats = rule_stats_[index];
+  return true;
+}
+#endif  // WAVESHARE_CAN_RULES
+
+#if WAVESHARE_CAN_RTR_RESPONDER
+bool WaveshareCan::SetRtrResponse(uint32_t id, bool extended,
+                                  const uint8_t* data, uint8_t length) {
+  if (length > TWAI_FRAME_MAX_DLC || (length > 0 && data == nullptr)) {
+    return false;
+  }
+  uint32_t key = id | (extended ? kExtendedKeyFlag : 0);
+
+  portENTER_CRITICAL(&rtr_lock_);
+  uint32_t count = rtr_response_count_;
+  uint32_t index = 0;
+  while (index < count && rtr_responses_[index].key != key) index++;
+  if (index >= kMaxRtrResponses) {
+    portEXIT_CRITICAL(&rtr_lock_);
+    return false;
+  }
+
+  RtrResponse& entry = rtr_responses_[index];
+  entry.seq.fetch_add(1, std::memory_order_relaxed);  // Odd: write in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  entry.key = key;
+  entry.length = length;
+  if (length > 0) memcpy(entry.data, data, length);
+  entry.seq.fetch_add(1, std::memory_order_release);  // Even: stable
+  if (index == count) rtr_response_count_ = count + 1;  // Publish new entry
+  portEXIT_CRITICAL(&rtr_lock_);
+  return true;
+}
+
+void WaveshareCan::ClearRtrResponses() {
+  portENTER_CRITICAL(&rtr_lock_);
+  rtr_response_count_ = 0;
+  portEXIT_CRITICAL(&rtr_lock_);
+}
+#endif  // WAVESHARE_CAN_RTR_RESPONDER
+
+bool WaveshareCan::GetStatus(twai_status_info_t* status) {
+  if (!initialized_ || !status) return false;
+  return ReadStatus(status, status_max_age_us_);
+}
+
+void WaveshareCan::SetStatusCacheMaxAge(uint32_t max_age_us) {
+  status_max_age_us_ = max_age_us;
+}
+
+bool WAVESHARE_CAN_HOT WaveshareCan::FetchStatus(twai_status_info_t* status) {
+#if WAVESHARE_CAN_LOW_LEVEL
+  if (low_level_) {
+    ll_backend_.GetStatus(status);
+  } else if (twai_get_status_info(status) != ESP_OK) {
+    return false;
+  }
+#else
+  if (twai_get_status_info(status) != ESP_OK) return false;
+#endif
+
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&status_cache_lock_);
+  status_seq_.fetch_add(1, std::memory_order_relaxed);  // Odd: write in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  status_cache_ = *status;
+  status_cache_us_ = now;
+  status_seq_.fetch_add(1, std::memory_order_release);  // Even: stable
+  portEXIT_CRITICAL(&status_cache_lock_);
+  return true;
+}
+
+bool WAVESHARE_CAN_HOT WaveshareCan::GetCachedStatus(twai_status_info_t* status,
+                                                     uint32_t* age_us) {
+  if (status == nullptr) return false;
+
+  int64_t taken_us;
+  uint32_t seq;
+  do {
+    seq = status_seq_.load(std::memory_order_acquire);
+    if (seq & 1) continue;  // Writer active - retry
+    *status = status_cache_;
+    taken_us = status_cache_us_;
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) || seq != status_seq_.load(std::memory_order_relaxed));
+
+  if (taken_us == 0) return false;
+  if (age_us) *age_us = static_cast<uint32_t>(esp_timer_get_time() - taken_us);
+  return true;
+}
+
+bool WaveshareCan::ReadStatus(twai_status_info_t* status, uint32_t max_age_us) {
+  uint32_t age;
+  if (max_age_us > 0 && GetCachedStatus(status, &age) && age <= max_age_us) {
+    return true;
+  }
+  return FetchStatus(status);
+}
+
+bool WaveshareCan::SetListenOnly(bool listen_only) {
+  if (initialized_ && listen_only_ != listen_only) {
+    End();
+    listen_only_ = listen_only;
+    return Restart();
+  }
+  listen_only_ = listen_only;
+  return true;
+}
+
+bool WaveshareCan::ProcessAlerts(uint32_t* alerts_triggered) {
+  if (!initialized_ || low_level_) return false;
+
+  uint32_t alerts = 0;
+  if (twai_read_alerts(&alerts, pdMS_TO_TICKS(0)) != ESP_OK || alerts == 0) {
+    FlushCoalescedAlerts(false);  // Interval may have run out meanwhile
+    return false;
+  }
+
+  if (alerts_triggered) *alerts_triggered = alerts;
+
+  CountAlerts(alerts);
+#if WAVESHARE_CAN_TX_LATENCY
+  TrackTxCompletions(alerts);
+#endif
+  CheckRxWatchdog();
+  HandleAlerts(alerts);
+  DeliverAlerts(alerts);
+
+  return true;
+}
+
+void WaveshareCan::OnAlert(void (*callback)(uint32_t)) {
+  alert_callback_ = callback;
+}
+
+void WaveshareCan::HandleAlerts(uint32_t alerts) {
+  // Recovery always runs; only the logging below is rate limited
+  if (alerts & TWAI_ALERT_BUS_OFF) {
+    twai_initiate_recovery();
+  }
+
+  const uint32_t logged = TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED |
+                          TWAI_ALERT_ERR_PASS | TWAI_ALERT_BUS_ERROR |
+                          TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_TX_FAILED;
+  if (!(alerts & logged)) return;
+
+  // During an alert storm (e.g. wiring fault) drop log lines instead of
+  // spending the CPU in Serial
+  if (BucketWaitUs(&alert_log_bucket_, 1, esp_timer_get_time()) != 0) {
+    AddAlertStat(&alert_stats_.log_suppressed);
+    return;
+  }
+  alert_log_bucket_.tokens -= 1000000;
+
+  twai_status_info_t status;
+  FetchStatus(&status);
+
+  if (alerts & TWAI_ALERT_BUS_OFF) {
+    CanLog::Println("BUS-OFF -> trying recovery");
+  }
+  if (alerts & TWAI_ALERT_BUS_RECOVERED) {
+    CanLog::Println("Bus recovered");
+  }
+  if (alerts & TWAI_ALERT_ERR_PASS) {
+    CanLog::Println("Error passive state");
+  }
+  if (alerts & TWAI_ALERT_BUS_ERROR) {
+    CanLog::Printf("Bus error - count: %d", status.bus_error_count);
+  }
+  if (alerts & TWAI_ALERT_RX_QUEUE_FULL) {
+    CanLog::Printf("RX queue full - buffered:%d missed:%d overrun:%d",
+             status.msgs_to_rx, status.rx_missed_count, status.rx_overrun_count);
+  }
+  if (alerts & TWAI_ALERT_TX_FAILED) {
+    CanLog::Printf("TX failed - buffered:%d errors:%d failed:%d",
+             status.msgs_to_tx, status.tx_error_counter, status.tx_failed_count);
+  }
+}
+
+bool WaveshareCan::EnableAlertInterrupt(void (*callback)(uint32_t)) {
+  if (!initialized_) {
+    CanLog::Println("Cannot enable alert interrupt: CAN not initialized");
+    return false;
+  }
+
+  if (low_level_) {
+    CanLog::Println("Alerts are not available with the register backend");
+    return false;
+  }
+
+  if (alert_interrupt_enabled_) {
+    CanLog::Println("Alert interrupt already enabled");
+    return true;
+  }
+
+  if (callback) {
+    alert_callback_ = callback;
+  }
+
+  // CRITICAL: Set flag BEFORE creating task to avoid race condition
+  alert_interrupt_enabled_ = true;
+
+  alert_task_start_us_ = esp_timer_get_time();
+  alert_run_time_ = RunTimeTotal();
+  BaseType_t result = xTaskCreate(
+      AlertTaskWrapper,
+      "can_alert_task",
+      alert_stack_words_,  // Already in words
+      this,
+      4,
+      &alert_task_handle_);
+
+  if (result != pdPASS) {
+    CanLog::Println("Failed to create alert task");
+    alert_task_handle_ = nullptr;
+    alert_interrupt_enabled_ = false;  // Rollback
+    return false;
+  }
+
+  CanLog::Println("Alert interrupt enabled");
+  return true;
+}
+
+void WaveshareCan::DisableAlertInterrupt() {
+  if (!alert_interrupt_enabled_) return;
+
+  alert_interrupt_enabled_ = false;
+
+  // Wait for task to self-delete
+  if (alert_task_handle_ != nullptr) {
+    uint32_t wait_count = 0;
+    while (alert_task_handle_ != nullptr && wait_count < 50) {  // Max 500ms
+      vTaskDelay(pdMS_TO_TICKS(10));
+      wait_count++;
+    }
+    
+    if (alert_task_handle_ != nullptr) {
+      CanLog::Println("WARNING: Alert task did not exit cleanly");
+      alert_task_handle_ = nullptr;
+    }
+  }
+
+  CanLog::Println("Alert interrupt disabled");
+}
+
+void WaveshareCan::AlertTaskWrapper(void* arg) {
+  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
+  instance->AlertTask();
+}
+
+void WaveshareCan::AlertTask() {
+  // Note: No Serial - causes stack overflow
+  uint32_t alerts = 0;
+  uint32_t check_counter = 0;
+
+  while (alert_interrupt_enabled_ && initialized_ && !shutdown_) {
+    // With alerts pending, wake up when the coalescing interval ends or
+    // the rate limit has a token again
+    TickType_t wait = pdMS_TO_TICKS(100);
+    if (pending_alerts_ != 0) {
+      int64_t now = esp_timer_get_time();
+      int64_t left = last_alert_delivery_us_ + alert_coalesce_us_ - now;
+      int64_t token_wait = BucketWaitUs(&alert_rate_bucket_, 1, now);
+      if (token_wait > left) left = token_wait;
+      wait = left > 0 ? pdMS_TO_TICKS((left + 999) / 1000) : 0;
+    }
+    esp_err_t err = twai_read_alerts(&alerts, wait);
+    
+    if (err == ESP_OK && alerts != 0) {
+      // Same recovery as HandleAlerts(), without its logging
+      if (alerts & TWAI_ALERT_BUS_OFF) twai_initiate_recovery();
+
+      CountAlerts(alerts);
+#if WAVESHARE_CAN_TX_LATENCY
+      TrackTxCompletions(alerts);
+#endif
+
+      // Alerts mean the status changed - refresh the cache right away
+      twai_status_info_t status;
+      if (status_max_age_us_ > 0) FetchStatus(&status);
+
+      // Only call user callback - NO HandleAlerts (has Serial.printf)
+      DeliverAlerts(alerts);
+    } else if (err == ESP_ERR_TIMEOUT) {
+      FlushCoalescedAlerts(false);
+      if (pending_alerts_ == 0) vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+    CheckRxWatchdog();
+
+    // Periodic stack monitoring (no Serial)
+    if (++check_counter % 1000 == 0) {
+      uint32_t free_stack = uxTaskGetStackHighWaterMark(NULL);
+      (void)free_stack;  // Suppress unused warning
+    }
+  }
+  
+  // Task exits cleanly - self-delete
+  alert_task_handle_ = nullptr;
+  vTaskDelete(NULL);
+}
+
+void WaveshareCan::OnReceive(void (*callback)(const twai_message_t& msg)) {
+  rx_callback_ = callback;
+}
+
+void WaveshareCan::OnReceiveBatch(void (*callback)(const twai_message_t* msgs,
+                                                  size_t count)) {
+  rx_batch_callback_ = callback;
+}
+
+#if WAVESHARE_CAN_RX_BATCHING
+void WaveshareCan::SetRxBatching(RxBatchMode mode, uint16_t max_frames,
+                                 uint32_t max_delay_us,
+                                 uint32_t rate_threshold) {
+  if (max_frames == 0) max_frames = 1;
+  if (max_frames > kMaxRxBatch) max_frames = kMaxRxBatch;
+
+  // Picked up by the RX task at its next rate window
+  rx_batch_max_frames_ = max_frames;
+  rx_batch_max_delay_us_ = max_delay_us;
+  rx_batch_rate_threshold_ = rate_threshold;
+  rx_batch_mode_ = mode;
+}
+#endif  // WAVESHARE_CAN_RX_BATCHING
+
+bool WaveshareCan::EnableRxInterrupt(void (*callback)(const twai_message_t& msg)) {
+  return StartRxTask(callback, -1);
+}
+
+bool WaveshareCan::EnableRxBusyPoll(int core,
+                                    void (*callback)(const twai_message_t& msg)) {
+  if (core < 0 || core > 1) {
+    CanLog::Println("Busy-poll core must be 0 or 1");
+    return false;
+  }
+  return StartRxTask(callback, core);
+}
+
+bool WaveshareCan::StartRxTask(void (*callback)(const twai_message_t& msg),
+                               int core) {
+  if (!initialized_) {
+    CanLog::Println("Cannot enable RX interrupt: CAN not initialized");
+    return false;
+  }
+
+  if (rx_interrupt_enabled_) {
+    CanLog::Println("RX interrupt already enabled");
+    return true;
+  }
+
+  if (callback) {
+    rx_callback_ = callback;
+  }
+
+  shutdown_ = false;
+
+  // No producer yet - drop frames left over from a previous session
+  rx_ring_.Clear();
+#if WAVESHARE_CAN_RX_PRIORITY
+  rx_priority_ring_.Clear();
+#endif
+
+  rx_interrupt_enabled_ = true;
+  rx_busy_poll_core_ = core;
+
+  BaseType_t result;
+  rx_task_start_us_ = esp_timer_get_time();
+  rx_run_time_ = RunTimeTotal();
+  if (core < 0) {
+    result = xTaskCreate(
+        RxTaskWrapper,
+        "can_rx_task",
+        rx_stack_words_,
+        this,
+        5,
+        &rx_task_handle_);
+  } else {
+    // The spinning task starves IDLE on its core - silence that core's
+    // idle watchdog for as long as we poll
+    if (core == 0) {
+      disableCore0WDT();
+    } else {
+      disableCore1WDT();
+    }
+    result = xTaskCreatePinnedToCore(
+        RxTaskWrapper,
+        "can_rx_poll",
+        rx_stack_words_,
+        this,
+        5,
+        &rx_task_handle_,
+        core);
+  }
+
+  if (result != pdPASS) {
+    CanLog::Println("Failed to create RX task");
+    if (core == 0) enableCore0WDT();
+    if (core == 1) enableCore1WDT();
+    rx_busy_poll_core_ = -1;
+    rx_task_handle_ = nullptr;
+    rx_interrupt_enabled_ = false;
+    return false;
+  }
+
+  CanLog::Println("RX interrupt enabled");
+  return true;
+}
+
+void WaveshareCan::DisableRxInterrupt() {
+  if (!rx_interrupt_enabled_) return;
+
+  rx_interrupt_enabled_ = false;
+
+  // Wait for task to self-delete (checks flag every 100ms + processing time)
+  if (rx_task_handle_ != nullptr) {
+    // Task will see flag change and self-delete within ~200ms
+    uint32_t wait_count = 0;
     while (rx_task_handle_ != nullptr && wait_count < 50) {  // Max 500ms
       vTaskDelay(pdMS_TO_TICKS(10));
       wait_count++;
     }
-    
-    if (rx_task_handle_ != nullptr) {
-      Serial.println("WARNING: RX task did not exit cleanly");
-      rx_task_handle_ = nullptr;
+    
+    if (rx_task_handle_ != nullptr) {
+      CanLog::Println("WARNING: RX task did not exit cleanly");
+      rx_task_handle_ = nullptr;
+    }
+  }
+
+  if (rx_busy_poll_core_ == 0) enableCore0WDT();
+  if (rx_busy_poll_core_ == 1) enableCore1WDT();
+  rx_busy_poll_core_ = -1;
+
+  CanLog::Println("RX interrupt disabled");
+}
+
+void WaveshareCan::RxTaskWrapper(void* arg) {
+  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
+  instance->RxTask();
+}
+
+void WAVESHARE_CAN_HOT WaveshareCan::RxTask() {
+  twai_message_t message;
+  uint32_t check_counter = 0;
+  const bool busy_poll = (rx_busy_poll_core_ >= 0);
+  bool batch_pending = false;  // Frames held for batched delivery
+
+#if WAVESHARE_CAN_RX_BATCHING
+  rx_batch_count_ = 0;
+  rx_window_frames_ = 0;
+  rx_window_start_us_ = esp_timer_get_time();
+  rx_rate_avg_ = 0;
+  rx_batching_ = (rx_batch_mode_ == kRxBatchAlways);
+#endif
+
+  while (rx_interrupt_enabled_ && initialized_ && !shutdown_) {
+    rx_progress_++;  // Heartbeat for CheckRxWatchdog()
+
+    // Use timeout instead of infinite block for clean shutdown.
+    // With a batch pending, wake up in time to honor its max delay.
+    // Busy-poll mode never blocks.
+    TickType_t wait = pdMS_TO_TICKS(100);
+    if (busy_poll) {
+      wait = 0;
+    } else if (batch_pending) {
+#if WAVESHARE_CAN_RX_BATCHING
+      int64_t left = rx_batch_start_us_ + rx_batch_max_delay_us_ -
+                     esp_timer_get_time();
+      wait = left > 0 ? pdMS_TO_TICKS((left + 999) / 1000) : 0;
+#endif
+    }
+    esp_err_t err = ReceiveFromController(&message, wait);
+    
+    if (err == ESP_OK) {
+      // Process first message
+      DispatchRx(message);
+
+      // DRAIN: Get all remaining messages immediately (burst handling)
+      while (ReceiveFromController(&message, 0) == ESP_OK) {
+        rx_progress_++;
+        DispatchRx(message);
+      }
+
+      // Keep the status cache warm for Available()/GetStatus() callers
+      uint32_t max_age = status_max_age_us_;
+      uint32_t age;
+      twai_status_info_t status;
+      if (max_age > 0 &&
+          (!GetCachedStatus(&status, &age) || age > max_age / 2)) {
+        FetchStatus(&status);
+      }
+      
+    } else if (err == ESP_ERR_TIMEOUT && !batch_pending && !busy_poll) {
+      // Normal - no messages, continue
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+#if WAVESHARE_CAN_RX_BATCHING
+    int64_t now = esp_timer_get_time();
+    if (rx_batch_count_ > 0 &&
+        now - rx_batch_start_us_ >= static_cast<int64_t>(rx_batch_max_delay_us_)) {
+      FlushRxBatch();
+    }
+    UpdateRxBatchMode(now);
+    batch_pending = (rx_batch_count_ > 0);
+#endif
+
+    // Periodic stack monitoring (no Serial - causes overflow).
+    // Busy-poll passes are ~1000x more frequent, so check less often.
+    if (++check_counter % (busy_poll ? 1000000 : 1000) == 0) {
+      uint32_t free_stack = uxTaskGetStackHighWaterMark(NULL);
+      if (free_stack < kStackLowWords) {
+        rx_stack_low_ = true;  // Reported via GetTaskStats()
+      }
+    }
+  }
+
+#if WAVESHARE_CAN_RX_BATCHING
+  FlushRxBatch();
+#endif
+
+  // Task exits cleanly - self-delete
+  rx_task_handle_ = nullptr;
+  vTaskDelete(NULL);
+}
+
+void WAVESHARE_CAN_HOT WaveshareCan::DispatchRx(const twai_message_t& message) {
+#if WAVESHARE_CAN_RX_BATCHING
+  rx_window_frames_++;
+#endif
+
+#if WAVESHARE_CAN_RULES
+  if (rule_count_ > 0) RunRules(message);
+#endif
+#if WAVESHARE_CAN_RTR_RESPONDER
+  if (message.rtr && rtr_response_count_ > 0) AnswerRtr(message);
+#endif
+
+  if (rx_id_set_active_ && rx_id_set_.Find(message.identifier, message.extd) < 0) {
+    CanStats::Add(rx_id_rejected_count_);
+    return;
+  }
+
+#if WAVESHARE_CAN_FILTER_PROGRAM
+  if (rx_program_active_ && !rx_program_.Matches(message)) {
+    CanStats::Add(rx_program_rejected_count_);
+    return;
+  }
+#endif
+
+#if WAVESHARE_CAN_RX_BATCHING
+  if (rx_batching_) {
+    if (rx_batch_count_ == 0) rx_batch_start_us_ = esp_timer_get_time();
+    rx_batch_[rx_batch_count_++] = message;
+    if (rx_batch_count_ >= rx_batch_max_frames_) FlushRxBatch();
+  } else
+#endif
+  if (rx_callback_) {
+    int64_t start = esp_timer_get_time();
+    rx_callback_(message);
+    RecordCallbackTime(static_cast<uint32_t>(esp_timer_get_time() - start),
+                       false);
+  } else if (rx_batch_callback_) {
+    InvokeBatchCallback(&message, 1);
+  }
+
+#if WAVESHARE_CAN_SHARED_RX
+  if (rx_subscriber_count_ > 0) PublishShared(message);
+#endif
+
+#if WAVESHARE_CAN_RX_PRIORITY
+  // Try to queue message - control frames get their own lane
+  uint32_t count = rx_priority_range_count_;
+  if (count > 0) {
+    uint32_t key = message.identifier | (message.extd ? kExtendedKeyFlag : 0);
+    for (uint32_t i = 0; i < count; i++) {
+      if (key >= rx_priority_ranges_[i].first_key &&
+          key <= rx_priority_ranges_[i].last_key) {
+        if (!rx_priority_ring_.Push(message)) {
+          CanStats::Add(rx_priority_dropped_count_);
+          return;
+        }
+        UpdateRxHighWater();
+        return;
+      }
+    }
+  }
+#endif  // WAVESHARE_CAN_RX_PRIORITY
+
+  if (!rx_ring_.Push(message)) {
+    CanStats::Add(rx_dropped_count_);
+    // Note: Serial removed - causes stack overflow
+    return;
+  }
+
+  UpdateRxHighWater();
+}
+
+// Same total as GetTaskStats().rx_queue_depth: both lanes together
+void WAVESHARE_CAN_HOT WaveshareCan::UpdateRxHighWater() {
+  uint32_t depth = RxQueueDepth();
+  if (depth > rx_queue_high_water_) rx_queue_high_water_ = depth;
+}
+
+uint32_t WAVESHARE_CAN_HOT WaveshareCan::RxQueueDepth() const {
+#if WAVESHARE_CAN_RX_PRIORITY
+  return rx_ring_.Size() + rx_priority_ring_.Size();
+#else
+  return rx_ring_.Size();
+#endif
+}
+
+#if WAVESHARE_CAN_RULES
+// Latency runs from the RX task picking up the frame to the last action
+// being issued (GPIO written / frame handed to the TX path).
+void WAVESHARE_CAN_HOT WaveshareCan::RunRules(const twai_message_t& message) {
+  int64_t start = esp_timer_get_time();
+  uint32_t count = rule_count_;
+  for (uint32_t i = 0; i < count; i++) {
+    const CanRule& rule = rules_[i];
+    if (!rule.Matches(message)) continue;
+
+    CanRuleStats& stats = rule_stats_[i];
+    if (rule.actions & CanRule::kActionGpio) {
+      gpio_set_level(static_cast<gpio_num_t>(rule.gpio_pin), rule.gpio_level);
+    }
+    if (rule.actions & CanRule::kActionSend) {
+      TxItem item;
+      item.message = rule.tx;
+      item.deadline_us = 0;
+      item.mailbox = -1;
+      item.enqueue_us = start;
+      if (listen_only_ || !SubmitFrame(item, 0, true)) {
+        CanStats::Add(stats.tx_failed);
+      }
+    }
+
+    uint32_t latency = static_cast<uint32_t>(esp_timer_get_time() - start);
+    stats.fired++;
+    stats.last_latency_us = latency;
+    stats.total_latency_us += latency;
+    if (latency > stats.max_latency_us) stats.max_latency_us = latency;
+  }
+}
+#endif  // WAVESHARE_CAN_RULES
+
+#if WAVESHARE_CAN_RTR_RESPONDER
+void WAVESHARE_CAN_HOT WaveshareCan::AnswerRtr(const twai_message_t& message) {
+  uint32_t key = message.identifier | (message.extd ? kExtendedKeyFlag : 0);
+  uint32_t count = rtr_response_count_;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; i++) {
+    const RtrResponse& entry = rtr_responses_[i];
+    if (entry.key != key) continue;
+
+    TxItem item;
+    item.message = twai_message_t();
+    item.message.identifier = message.identifier;
+    item.message.extd = message.extd;
+    uint32_t seq;
+    uint32_t entry_key;
+    do {
+      seq = entry.seq.load(std::memory_order_acquire);
+      if (seq & 1) continue;  // Writer active - retry
+      entry_key = entry.key;
+      item.message.data_length_code = entry.length;
+      memcpy(item.message.data, entry.data, TWAI_FRAME_MAX_DLC);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != entry.seq.load(std::memory_order_relaxed));
+    if (entry_key != key) continue;  // Slot reused after ClearRtrResponses()
+
+    item.deadline_us = 0;
+    item.mailbox = -1;
+    item.enqueue_us = esp_timer_get_time();
+    if (listen_only_ || !SubmitFrame(item, 0, true)) {
+      CanStats::Add(rtr_failed_count_);
+    } else {
+      CanStats::Add(rtr_answered_count_);
+    }
+    return;
+  }
+}
+#endif  // WAVESHARE_CAN_RTR_RESPONDER
+
+#if WAVESHARE_CAN_SHARED_RX
+void WAVESHARE_CAN_HOT WaveshareCan::PublishShared(
+    const twai_message_t& message) {
+  uint32_t count = rx_subscriber_count_;
+  // One reference per subscriber up front, so an early consumer can never
+  // free the slot while we are still handing it out
+  CanPooledFrame* slot = frame_pool_.Acquire(message, count);
+  if (slot == nullptr) return;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (!rx_subscribers_[i].Push(slot)) {
+      CanStats::Add(rx_subscriber_drops_[i]);
+      slot->refs.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+}
+#endif  // WAVESHARE_CAN_SHARED_RX
+
+#if WAVESHARE_CAN_RX_BATCHING
+void WAVESHARE_CAN_HOT WaveshareCan::FlushRxBatch() {
+  if (rx_batch_count_ == 0) return;
+
+  if (rx_batch_callback_) {
+    InvokeBatchCallback(rx_batch_, rx_batch_count_);
+  } else if (rx_callback_) {
+    // No batch callback - still deliver every frame, each timed on its own
+    // so the stats match the unbatched path
+    for (uint16_t i = 0; i < rx_batch_count_; i++) {
+      int64_t start = esp_timer_get_time();
+      rx_callback_(rx_batch_[i]);
+      RecordCallbackTime(static_cast<uint32_t>(esp_timer_get_time() - start),
+                         false);
     }
   }
+  rx_batch_count_ = 0;
+}
+#endif
+
+void WAVESHARE_CAN_HOT WaveshareCan::InvokeBatchCallback(const twai_message_t* msgs,
+                                                         size_t count) {
+  int64_t start = esp_timer_get_time();
+  rx_batch_callback_(msgs, count);
+  RecordCallbackTime(static_cast<uint32_t>(esp_timer_get_time() - start),
+                     false);
+}
 
-  if (rx_queue_ != nullptr) {
-    vQueueDelete(rx_queue_);
-    rx_queue_ = nullptr;
+#if WAVESHARE_CAN_RX_BATCHING
+void WAVESHARE_CAN_HOT WaveshareCan::UpdateRxBatchMode(int64_t now_us) {
+  int64_t elapsed = now_us - rx_window_start_us_;
+  if (elapsed < kRxRateWindowUs) return;
+
+  // Arrival rate of the last window, smoothed (EWMA, alpha = 1/4)
+  uint32_t rate = static_cast<uint32_t>(
+      static_cast<uint64_t>(rx_window_frames_) * 1000000 / elapsed);
+  rx_rate_avg_ = rx_rate_avg_ - rx_rate_avg_ / 4 + rate / 4;
+  rx_window_frames_ = 0;
+  rx_window_start_us_ = now_us;
+
+  bool batching = rx_batching_;
+  switch (rx_batch_mode_) {
+    case kRxBatchOff:
+      batching = false;
+      break;
+    case kRxBatchAlways:
+      batching = true;
+      break;
+    case kRxBatchAdaptive:
+      // Hysteresis: enter above threshold, leave below half of it
+      if (rx_rate_avg_ > rx_batch_rate_threshold_) {
+        batching = true;
+      } else if (rx_rate_avg_ < rx_batch_rate_threshold_ / 2) {
+        batching = false;
+      }
+      break;
   }
 
-  Serial.println("RX interrupt disabled");
+  if (!batching) FlushRxBatch();
+  rx_batching_ = batching;
 }
+#endif
 
-void WaveshareCan::RxTaskWrapper(void* arg) {
-  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
-  instance->RxTask();
+bool WaveshareCan::EnableTxQueue(uint16_t depth) {
+  if (!initialized_) {
+    CanLog::Println("Cannot enable TX queue: CAN not initialized");
+    return false;
+  }
+
+  if (tx_queue_enabled_) {
+    CanLog::Println("TX queue already enabled");
+    return true;
+  }
+
+  if (!tx_queue_.Init(depth)) {
+    CanLog::Println("Failed to create TX queue");
+    return false;
+  }
+
+  tx_task_waiting_ = false;
+  tx_queue_enabled_ = true;
+
+  tx_task_start_us_ = esp_timer_get_time();
+  tx_run_time_ = RunTimeTotal();
+  BaseType_t result = xTaskCreate(
+      TxTaskWrapper,
+      "can_tx_task",
+      tx_stack_words_,
+      this,
+      5,
+      &tx_task_handle_);
+
+  if (result != pdPASS) {
+    CanLog::Println("Failed to create TX task");
+    tx_queue_enabled_ = false;
+    while (tx_producers_.load() != 0) vTaskDelay(1);
+    tx_queue_.Free();
+    tx_task_handle_ = nullptr;
+    return false;
+  }
+
+  CanLog::Println("TX queue enabled");
+  return true;
 }
 
-void WaveshareCan::RxTask() {
-  twai_message_t message;
-  uint32_t check_counter = 0;
+void WaveshareCan::DisableTxQueue() {
+  if (!tx_queue_enabled_) return;
 
-  while (rx_interrupt_enabled_ && initialized_ && !shutdown_) {
-    // Use timeout instead of infinite block for clean shutdown
-    esp_err_t err = twai_receive(&message, pdMS_TO_TICKS(100));
-    
-    if (err == ESP_OK) {
-      // Process first message
-      if (rx_callback_) {
-        rx_callback_(message);
-      }
+  tx_queue_enabled_ = false;
 
-      // Try to queue message
-      if (xQueueSend(rx_queue_, &message, 0) != pdTRUE) {
-        rx_dropped_count_++;
-        // Note: Serial removed - causes stack overflow
-      }
+  // Producers that saw the queue enabled may still be inside Push() or
+  // about to notify the TX task - let them leave before the task and the
+  // queue storage go away (EnqueueTx() gives up once the flag is clear)
+  while (tx_producers_.load() != 0) vTaskDelay(1);
 
-      // DRAIN: Get all remaining messages immediately (burst handling)
-      while (twai_receive(&message, 0) == ESP_OK) {
-        if (rx_callback_) {
-          rx_callback_(message);
-        }
+  // Wait for task to self-delete
+  if (tx_task_handle_ != nullptr) {
+    uint32_t wait_count = 0;
+    while (tx_task_handle_ != nullptr && wait_count < 50) {  // Max 500ms
+      vTaskDelay(pdMS_TO_TICKS(10));
+      wait_count++;
+    }
 
-        if (xQueueSend(rx_queue_, &message, 0) != pdTRUE) {
-          rx_dropped_count_++;
-        }
+    if (tx_task_handle_ != nullptr) {
+      CanLog::Println("WARNING: TX task did not exit cleanly");
+      tx_task_handle_ = nullptr;
+    }
+  }
+
+  tx_queue_.Free();
+
+  CanLog::Println("TX queue disabled");
+}
+
+void WaveshareCan::TxTaskWrapper(void* arg) {
+  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
+  instance->TxTask();
+}
+
+void WAVESHARE_CAN_HOT WaveshareCan::TxTask() {
+  // Note: No Serial - causes stack overflow
+  TxItem item;
+  tx_parked_count_ = 0;
+
+  while (tx_queue_enabled_ && initialized_ && !shutdown_) {
+    if (tx_parked_count_ > 0) ServiceParkedTx();
+
+    if (!tx_queue_.Pop(&item)) {
+      // Announce the sleep before looking again, so a producer pushing in
+      // between is guaranteed to see the flag and wake us. Parked frames
+      // need another look as soon as their bucket may have refilled.
+      tx_task_waiting_ = true;
+      bool got = tx_queue_.Pop(&item);
+      TickType_t idle = tx_parked_count_ > 0 ? 1 : pdMS_TO_TICKS(100);
+      if (!got) ulTaskNotifyTake(pdTRUE, idle);
+      tx_task_waiting_ = false;
+      if (!got) {
+        // Idle - still flush stale frames out of the driver queue
+        PurgeExpiredDriverTx();
+        continue;
       }
-      
-    } else if (err == ESP_ERR_TIMEOUT) {
-      // Normal - no messages, continue
-      vTaskDelay(pdMS_TO_TICKS(1));
     }
 
-    // Periodic stack monitoring (no Serial - causes overflow)
-    if (++check_counter % 1000 == 0) {
-      uint32_t free_stack = uxTaskGetStackHighWaterMark(NULL);
-      if (free_stack < 512) {
-        // Stack low - increment counter for external monitoring
-        rx_dropped_count_++;  // Reuse as warning indicator
+    // Mailbox reference: fetch the latest value (skip if already sent)
+    if (item.mailbox >= 0 && !TakeTxMailbox(&item)) continue;
+
+    // Queue mode: a per-ID limit parks the frame off to the side; the bus
+    // budget applies to every frame, so that one is waited out right here
+    // (until the deadline passes - HandOffToDriver() then discards it)
+    if (rate_limit_action_ == kRateLimitQueue) {
+      if (id_limits_active_ && ParkIfIdLimited(item)) continue;
+      bool admitted = AcquireTxTokens(item.message, pdMS_TO_TICKS(100));
+      while (!admitted && tx_queue_enabled_ && !shutdown_) {
+        if (item.deadline_us != 0 && esp_timer_get_time() >= item.deadline_us) {
+          break;
+        }
+        admitted = AcquireTxTokens(item.message, pdMS_TO_TICKS(100), false);
+      }
+      if (!admitted && (!tx_queue_enabled_ || shutdown_)) break;
+      if (!admitted) {
+        CanStats::Add(tx_expired_count_);
+        continue;
       }
     }
+
+    HandOffToDriver(item, pdMS_TO_TICKS(1000));
   }
 
   // Task exits cleanly - self-delete
-  rx_task_handle_ = nullptr;
+  tx_task_handle_ = nullptr;
   vTaskDelete(NULL);
 }
 
-int WaveshareCan::QueuedMessages() {
-  if (!rx_interrupt_enabled_ || rx_queue_ == nullptr) return 0;
-  return uxQueueMessagesWaiting(rx_queue_);
+uint32_t WaveshareCan::EnabledAlerts() const {
+  // User mask plus what the library itself depends on
+  uint32_t alerts = alert_mask_ | TWAI_ALERT_BUS_OFF;
+#if WAVESHARE_CAN_TX_LATENCY
+  if (tx_latency_enabled_) {
+    alerts |= TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_TX_FAILED | TWAI_ALERT_ARB_LOST;
+  }
+#endif
+  return alerts;
+}
+
+bool WaveshareCan::SetAlertMask(uint32_t mask) {
+  alert_mask_ = mask;
+  if (initialized_ && !low_level_ &&
+      twai_reconfigure_alerts(EnabledAlerts(), nullptr) != ESP_OK) {
+    CanLog::Println("Alerts reconfigure failed");
+    return false;
+  }
+  return true;
+}
+
+void WaveshareCan::SetAlertCoalescing(uint32_t interval_us) {
+  alert_coalesce_us_ = interval_us;
+}
+
+void WaveshareCan::DeliverAlerts(uint32_t alerts) {
+  alerts &= alert_mask_;
+
+  if (alert_coalesce_us_ == 0 && alert_rate_bucket_.rate == 0) {
+    if (alerts) InvokeAlertCallback(alerts);
+    return;
+  }
+
+  pending_alerts_ |= alerts;
+  bool rate_limited = false;
+  if (!FlushCoalescedAlerts((alerts & kUrgentAlerts) != 0, &rate_limited) &&
+      alerts) {
+    AddAlertStat(rate_limited ? &alert_stats_.suppressed
+                              : &alert_stats_.coalesced);
+  }
+}
+
+bool WaveshareCan::FlushCoalescedAlerts(bool force, bool* rate_limited) {
+  if (pending_alerts_ == 0) return false;
+
+  int64_t now = esp_timer_get_time();
+  if (!force) {
+    if (now - last_alert_delivery_us_ < alert_coalesce_us_) return false;
+    if (BucketWaitUs(&alert_rate_bucket_, 1, now) != 0) {
+      if (rate_limited) *rate_limited = true;
+      return false;
+    }
+  }
+  if (alert_rate_bucket_.rate && alert_rate_bucket_.tokens >= 1000000) {
+    alert_rate_bucket_.tokens -= 1000000;
+  }
+
+  uint32_t alerts = pending_alerts_;
+  pending_alerts_ = 0;
+  last_alert_delivery_us_ = now;
+  InvokeAlertCallback(alerts);
+  return true;
+}
+
+void WaveshareCan::SetAlertRateLimit(uint32_t callbacks_per_sec,
+                                     uint16_t burst) {
+  ConfigureBucket(&alert_rate_bucket_, callbacks_per_sec, burst ? burst : 1);
+}
+
+void WaveshareCan::CountAlerts(uint32_t alerts) {
+  int64_t now_sec = esp_timer_get_time() / 1000000;
+
+  portENTER_CRITICAL(&alert_stats_lock_);
+  CloseAlertSeconds(now_sec);
+  for (size_t bit = 0; bit < kAlertTypes; bit++) {
+    if (alerts & (1UL << bit)) {
+      alert_stats_.count[bit]++;
+      alert_stats_current_++;
+    }
+  }
+  portEXIT_CRITICAL(&alert_stats_lock_);
+}
+
+void WaveshareCan::CloseAlertSeconds(int64_t now_sec) {
+  // Caller holds alert_stats_lock_
+  if (!alert_stats_started_) {
+    alert_stats_second_ = now_sec;
+    alert_stats_started_ = true;
+  }
+
+  while (alert_stats_second_ < now_sec) {
+    uint32_t count = alert_stats_current_;
+    alert_stats_.per_second[alert_stats_written_ % kAlertRateSeconds] =
+        count > 0xFFFF ? 0xFFFF : count;
+    alert_stats_written_++;
+
+    size_t bucket = 0;
+    while (bucket < kAlertRateBuckets - 1 && (count >> (bucket + 1)) != 0) {
+      bucket++;
+    }
+    alert_stats_.rate_histogram[bucket]++;
+
+    alert_stats_current_ = 0;
+    alert_stats_second_++;
+
+    // Long quiet gap - account the remaining seconds in one step
+    int64_t gap = now_sec - alert_stats_second_;
+    if (gap > static_cast<int64_t>(kAlertRateSeconds)) {
+      alert_stats_.rate_histogram[0] += gap - kAlertRateSeconds;
+      alert_stats_second_ = now_sec - kAlertRateSeconds;
+    }
+  }
+}
+
+bool WaveshareCan::GetAlertStats(AlertStats* stats) {
+  if (stats == nullptr) return false;
+
+  portENTER_CRITICAL(&alert_stats_lock_);
+  CloseAlertSeconds(esp_timer_get_time() / 1000000);
+  *stats = alert_stats_;
+
+  // Unroll the ring so per_second[] is oldest first
+  uint32_t filled = alert_stats_written_ < kAlertRateSeconds
+                        ? alert_stats_written_
+                        : kAlertRateSeconds;
+  uint32_t first = alert_stats_written_ - filled;
+  for (size_t i = 0; i < kAlertRateSeconds; i++) {
+    stats->per_second[i] =
+        i < filled ? alert_stats_.per_second[(first + i) % kAlertRateSeconds] : 0;
+  }
+  portEXIT_CRITICAL(&alert_stats_lock_);
+  return true;
+}
+
+void WaveshareCan::ResetAlertStats() {
+  portENTER_CRITICAL(&alert_stats_lock_);
+  alert_stats_ = {};
+  alert_stats_started_ = false;
+  alert_stats_second_ = 0;
+  alert_stats_current_ = 0;
+  alert_stats_written_ = 0;
+  portEXIT_CRITICAL(&alert_stats_lock_);
+}
+
+void WaveshareCan::InvokeAlertCallback(uint32_t alerts) {
+  if (!alert_callback_) return;
+
+  AddAlertStat(&alert_stats_.callbacks);
+  int64_t start = esp_timer_get_time();
+  alert_callback_(alerts);
+  RecordCallbackTime(static_cast<uint32_t>(esp_timer_get_time() - start), true);
+}
+
+void WaveshareCan::AddAlertStat(uint32_t* counter) {
+  portENTER_CRITICAL(&alert_stats_lock_);
+  (*counter)++;
+  portEXIT_CRITICAL(&alert_stats_lock_);
+}
+
+#if WAVESHARE_CAN_TX_LATENCY
+bool WaveshareCan::EnableTxLatencyTracking(bool enable) {
+  if (enable && !tx_latency_enabled_) {
+    twai_status_info_t status;
+    portENTER_CRITICAL(&tx_stats_lock_);
+    tx_in_flight_head_ = 0;
+    tx_in_flight_count_ = 0;
+    portEXIT_CRITICAL(&tx_stats_lock_);
+    if (initialized_ && FetchStatus(&status)) {
+      tx_arb_lost_seen_ = status.arb_lost_count;
+    }
+  }
+  tx_latency_enabled_ = enable;
+
+  if (initialized_ && !low_level_ &&
+      twai_reconfigure_alerts(EnabledAlerts(), nullptr) != ESP_OK) {
+    CanLog::Println("Alerts reconfigure failed");
+    return false;
+  }
+  return true;
+}
+
+#if WAVESHARE_CAN_LOW_LEVEL
+// The register backend raises no alerts: the TX interrupt's timestamp and
+// the controller's last-TX status stand in for TX_SUCCESS / TX_FAILED
+void WaveshareCan::TrackLowLevelTx() {
+  if (!low_level_ || !tx_latency_enabled_ || tx_in_flight_count_ == 0) return;
+  portENTER_CRITICAL(&ll_tx_lock_);
+  bool sent = ll_backend_.LastTxSucceeded();
+  int64_t done_us = ll_tx_done_us_;
+  portEXIT_CRITICAL(&ll_tx_lock_);
+  TrackTxCompletions(sent ? TWAI_ALERT_TX_SUCCESS : TWAI_ALERT_TX_FAILED,
+                     done_us);
+}
+#endif  // WAVESHARE_CAN_LOW_LEVEL
+
+void WaveshareCan::TrackTxCompletions(uint32_t alerts, int64_t done_us) {
+  if (!tx_latency_enabled_) return;
+  if (!(alerts & (TWAI_ALERT_TX_SUCCESS | TWAI_ALERT_TX_FAILED |
+                  TWAI_ALERT_ARB_LOST))) {
+    return;
+  }
+
+  twai_status_info_t status;
+  if (!FetchStatus(&status)) return;
+
+  int64_t now = done_us ? done_us : esp_timer_get_time();
+  // Alert bits coalesce, so the number of finished frames comes from the
+  // driver's TX count rather than from the alerts themselves
+  bool failed_only = (alerts & TWAI_ALERT_TX_FAILED) &&
+                     !(alerts & TWAI_ALERT_TX_SUCCESS);
+
+  portENTER_CRITICAL(&tx_stats_lock_);
+  uint32_t arb_lost = status.arb_lost_count - tx_arb_lost_seen_;
+  tx_arb_lost_seen_ = status.arb_lost_count;
+  if (arb_lost && tx_in_flight_count_) {
+    // Losses belong to the frame currently at the head of the line
+    TxLatencyStats* stats = FindTxLatencyStats(tx_in_flight_[tx_in_flight_head_].key);
+    if (stats) stats->arb_lost += arb_lost;
+  }
+
+  while (tx_in_flight_count_ > status.msgs_to_tx) {
+    const TxInFlight& record = tx_in_flight_[tx_in_flight_head_];
+    tx_in_flight_head_ = (tx_in_flight_head_ + 1) % kTxInFlightSlots;
+    tx_in_flight_count_--;
+
+    TxLatencyStats* stats = failed_only ? nullptr : FindTxLatencyStats(record.key);
+    if (!stats) continue;
+
+    uint32_t queue_us = static_cast<uint32_t>(record.handoff_us - record.enqueue_us);
+    uint32_t total_us = static_cast<uint32_t>(now - record.enqueue_us);
+    size_t bucket = 0;
+    while (bucket < kTxLatencyBuckets - 1 && (total_us >> (bucket + 1)) != 0) {
+      bucket++;
+    }
+
+    stats->frames++;
+    stats->total_us_sum += total_us;
+    if (queue_us > stats->queue_us_max) stats->queue_us_max = queue_us;
+    if (total_us > stats->total_us_max) stats->total_us_max = total_us;
+    stats->histogram[bucket]++;
+  }
+  portEXIT_CRITICAL(&tx_stats_lock_);
+}
+
+WaveshareCan::TxLatencyStats* WaveshareCan::FindTxLatencyStats(uint32_t key) {
+  // Same probing scheme as FindIdRateLimit(); IDs beyond capacity are untracked
+  size_t index = (key * 2654435761u) & (kMaxTxLatencyIds - 1);
+  for (size_t i = 0; i < kMaxTxLatencyIds; i++) {
+    size_t slot = (index + i) & (kMaxTxLatencyIds - 1);
+    if (!tx_latency_used_[slot]) {
+      tx_latency_used_[slot] = true;
+      tx_latency_[slot] = {};
+      tx_latency_[slot].id = key & ~kExtendedKeyFlag;
+      tx_latency_[slot].extended = (key & kExtendedKeyFlag) != 0;
+      return &tx_latency_[slot];
+    }
+    if ((tx_latency_[slot].id | (tx_latency_[slot].extended ? kExtendedKeyFlag : 0)) == key) {
+      return &tx_latency_[slot];
+    }
+  }
+  return nullptr;
+}
+
+size_t WaveshareCan::GetTxLatencySnapshot(TxLatencyStats* out,
+                                          size_t max_entries) {
+  if (out == nullptr) return 0;
+#if WAVESHARE_CAN_LOW_LEVEL
+  TrackLowLevelTx();  // Nothing else retires the last frame sent
+#endif
+
+  size_t count = 0;
+  portENTER_CRITICAL(&tx_stats_lock_);
+  for (size_t i = 0; i < kMaxTxLatencyIds && count < max_entries; i++) {
+    if (tx_latency_used_[i]) out[count++] = tx_latency_[i];
+  }
+  portEXIT_CRITICAL(&tx_stats_lock_);
+  return count;
+}
+
+void WaveshareCan::ResetTxLatencyStats() {
+  portENTER_CRITICAL(&tx_stats_lock_);
+  for (size_t i = 0; i < kMaxTxLatencyIds; i++) {
+    tx_latency_used_[i] = false;
+  }
+  portEXIT_CRITICAL(&tx_stats_lock_);
+}
+#endif  // WAVESHARE_CAN_TX_LATENCY
+
+int WaveshareCan::QueuedTxMessages() {
+  if (!tx_queue_enabled_) return 0;
+  return tx_queue_.Size();
+}
+
+int WAVESHARE_CAN_HOT WaveshareCan::QueuedMessages() {
+  if (!rx_interrupt_enabled_) return 0;
+  return RxQueueDepth();
+}
+
+#if WAVESHARE_CAN_RX_PRIORITY
+int WaveshareCan::QueuedPriorityMessages() {
+  if (!rx_interrupt_enabled_) return 0;
+  return rx_priority_ring_.Size();
+}
+
+bool WaveshareCan::AddRxPriorityRange(uint32_t first_id, uint32_t last_id,
+                                      bool extended) {
+  uint32_t count = rx_priority_range_count_;
+  if (count >= kMaxRxPriorityRanges) return false;
+
+  if (first_id > last_id) {
+    uint32_t swap = first_id;
+    first_id = last_id;
+    last_id = swap;
+  }
+  uint32_t flag = extended ? kExtendedKeyFlag : 0;
+  rx_priority_ranges_[count].first_key = first_id | flag;
+  rx_priority_ranges_[count].last_key = last_id | flag;
+  // Entry complete before the RX task can see it
+  std::atomic_thread_fence(std::memory_order_release);
+  rx_priority_range_count_ = count + 1;
+  return true;
+}
+
+void WaveshareCan::ClearRxPriorityRanges() {
+  rx_priority_range_count_ = 0;
+}
+#endif  // WAVESHARE_CAN_RX_PRIORITY
+
+#if WAVESHARE_CAN_SHARED_RX
+int WaveshareCan::AddRxSubscriber() {
+  uint32_t count = rx_subscriber_count_;
+  if (count >= kMaxRxSubscribers) return -1;
+  rx_subscribers_[count].Clear();
+  rx_subscriber_drops_[count] = 0;
+  rx_subscriber_count_ = count + 1;
+  return count;
+}
+
+bool WaveshareCan::ClearRxSubscribers() {
+  if (rx_interrupt_enabled_) {
+    CanLog::Println("Cannot clear subscribers while RX interrupt is enabled");
+    return false;
+  }
+
+  uint32_t count = rx_subscriber_count_;
+  rx_subscriber_count_ = 0;
+  // Return references still queued to the pool
+  for (uint32_t i = 0; i < count; i++) {
+    CanFrameRef frame;
+    while (ReceiveShared(i, &frame)) frame.Reset();
+  }
+  return true;
+}
+
+bool WAVESHARE_CAN_HOT WaveshareCan::ReceiveShared(int subscriber,
+                                                   CanFrameRef* frame) {
+  if (subscriber < 0 || subscriber >= static_cast<int>(kMaxRxSubscribers) ||
+      frame == nullptr) {
+    return false;
+  }
+
+  CanPooledFrame* slot;
+  if (!rx_subscribers_[subscriber].Pop(&slot)) return false;
+  *frame = CanFrameRef::Adopt(slot);
+  return true;
+}
+
+WaveshareCan::FramePoolStats WaveshareCan::GetFramePoolStats() const {
+  FramePoolStats stats = {};
+  stats.slots = kFramePoolSlots;
+  stats.in_use = frame_pool_.InUse();
+  stats.exhausted = frame_pool_.GetExhaustedCount();
+  for (size_t i = 0; i < kMaxRxSubscribers; i++) {
+    stats.subscriber_drops[i] = rx_subscriber_drops_[i];
+  }
+  return stats;
 }
+#endif  // WAVESHARE_CAN_SHARED_RX
 
-int WaveshareCan::ReceiveFromQueue(uint32_t* id, bool* extended, uint8_t* data,
-                                   uint8_t* length, bool* rtr) {
-  if (!rx_interrupt_enabled_ || rx_queue_ == nullptr) return -1;
+int WAVESHARE_CAN_HOT WaveshareCan::ReceiveFromQueue(uint32_t* id,
+                                                     bool* extended,
+                                                     uint8_t* data,
+                                                     uint8_t* length,
+                                                     bool* rtr) {
+  if (!rx_interrupt_enabled_) return -1;
 
   twai_message_t message;
-  if (xQueueReceive(rx_queue_, &message, 0) != pdTRUE) {
+#if WAVESHARE_CAN_RX_PRIORITY
+  if (!rx_priority_ring_.Pop(&message) && !rx_ring_.Pop(&message)) {
+#else
+  if (!rx_ring_.Pop(&message)) {
+#endif
     return -1;  // No message available
   }
 
@@ -476,20 +2408,348 @@ int WaveshareCan::ReceiveFromQueue(uint32_t* id, bool* extended, uint8_t* data,
   return message.data_length_code;
 }
 
-WaveshareCan::TaskStats WaveshareCan::GetTaskStats() const {
-  TaskStats stats = {0, 0, kRxTaskStackSize * 4, kAlertTaskStackSize * 4};  // Convert words to bytes
-  
-  if (rx_task_handle_ != nullptr) {
-    stats.rx_stack_free = uxTaskGetStackHighWaterMark(rx_task_handle_);
+const twai_message_t* WAVESHARE_CAN_HOT WaveshareCan::BorrowRx() {
+  size_t count;
+  return BorrowRxSpan(&count);
+}
+
+const twai_message_t* WAVESHARE_CAN_HOT WaveshareCan::BorrowRxSpan(
+    size_t* count) {
+  size_t available = 0;
+  const twai_message_t* first = nullptr;
+  if (rx_interrupt_enabled_) {
+#if WAVESHARE_CAN_RX_PRIORITY
+    first = rx_priority_ring_.Peek(&available);
+    rx_borrowed_priority_ = (first != nullptr);
+    if (first == nullptr) first = rx_ring_.Peek(&available);
+#else
+    first = rx_ring_.Peek(&available);
+#endif
   }
-  if (alert_task_handle_ != nullptr) {
-    stats.alert_stack_free = uxTaskGetStackHighWaterMark(alert_task_handle_);
+  if (count) *count = available;
+  return first;
+}
+
+void WAVESHARE_CAN_HOT WaveshareCan::ReleaseRx(size_t n) {
+#if WAVESHARE_CAN_RX_PRIORITY
+  if (rx_borrowed_priority_) {
+    rx_priority_ring_.Release(n);
+    return;
   }
-  
+#endif
+  rx_ring_.Release(n);
+}
+
+#if WAVESHARE_CAN_ERROR_SAMPLER
+bool WaveshareCan::StartErrorSampler(uint32_t period_ms) {
+  if (error_sampler_ != nullptr) StopErrorSampler();
+  if (period_ms == 0) period_ms = 1;
+
+  esp_timer_create_args_t args = {};
+  args.callback = ErrorSamplerCallback;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "can_err_sampler";
+
+  if (esp_timer_create(&args, &error_sampler_) != ESP_OK) {
+    CanLog::Println("Failed to create error sampler timer");
+    error_sampler_ = nullptr;
+    return false;
+  }
+
+  portENTER_CRITICAL(&error_sample_lock_);
+  error_sample_count_ = 0;
+  error_sample_prev_ = {};
+  portEXIT_CRITICAL(&error_sample_lock_);
+  if (initialized_) FetchStatus(&error_sample_prev_);
+
+  if (esp_timer_start_periodic(error_sampler_,
+                               static_cast<uint64_t>(period_ms) * 1000) != ESP_OK) {
+    CanLog::Println("Failed to start error sampler timer");
+    esp_timer_delete(error_sampler_);
+    error_sampler_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void WaveshareCan::StopErrorSampler() {
+  if (error_sampler_ == nullptr) return;
+  esp_timer_stop(error_sampler_);
+  esp_timer_delete(error_sampler_);
+  error_sampler_ = nullptr;
+}
+
+void WaveshareCan::ErrorSamplerCallback(void* arg) {
+  WaveshareCan* instance = static_cast<WaveshareCan*>(arg);
+  instance->SampleErrors();
+}
+
+void WaveshareCan::SampleErrors() {
+  // Runs in the esp_timer task - keep it short, no Serial
+  twai_status_info_t status;
+  if (!initialized_ || !FetchStatus(&status)) return;
+
+  ErrorSample sample;
+  sample.time_ms = millis();
+  sample.state = static_cast<uint8_t>(status.state);
+  sample.tx_error_counter = status.tx_error_counter > 255 ? 255 : status.tx_error_counter;
+  sample.rx_error_counter = status.rx_error_counter > 255 ? 255 : status.rx_error_counter;
+
+  // Driver counters only grow (until reinstall) - a drop means Begin() ran
+  const twai_status_info_t& prev = error_sample_prev_;
+  uint32_t bus_errors = status.bus_error_count >= prev.bus_error_count
+                            ? status.bus_error_count - prev.bus_error_count
+                            : status.bus_error_count;
+  uint32_t tx_failed = status.tx_failed_count >= prev.tx_failed_count
+                           ? status.tx_failed_count - prev.tx_failed_count
+                           : status.tx_failed_count;
+  uint32_t rx_lost_now = status.rx_missed_count + status.rx_overrun_count;
+  uint32_t rx_lost_prev = prev.rx_missed_count + prev.rx_overrun_count;
+  uint32_t rx_lost = rx_lost_now >= rx_lost_prev ? rx_lost_now - rx_lost_prev
+                                                 : rx_lost_now;
+  sample.bus_errors = bus_errors > 0xFFFF ? 0xFFFF : bus_errors;
+  sample.tx_failed = tx_failed > 0xFFFF ? 0xFFFF : tx_failed;
+  sample.rx_lost = rx_lost > 0xFFFF ? 0xFFFF : rx_lost;
+
+  CheckRxWatchdog();
+
+  portENTER_CRITICAL(&error_sample_lock_);
+  error_sample_prev_ = status;
+  error_samples_[error_sample_count_ % kErrorSampleSlots] = sample;
+  error_sample_count_++;
+  portEXIT_CRITICAL(&error_sample_lock_);
+}
+
+size_t WaveshareCan::GetErrorSamples(ErrorSample* out, size_t max_samples) {
+  if (out == nullptr) return 0;
+
+  portENTER_CRITICAL(&error_sample_lock_);
+  uint32_t total = error_sample_count_;
+  size_t available = total < kErrorSampleSlots ? total : kErrorSampleSlots;
+  size_t count = available < max_samples ? available : max_samples;
+  uint32_t first = total - count;
+  for (size_t i = 0; i < count; i++) {
+    out[i] = error_samples_[(first + i) % kErrorSampleSlots];
+  }
+  portEXIT_CRITICAL(&error_sample_lock_);
+
+  return count;
+}
+
+uint8_t WaveshareCan::GetBusHealthScore() {
+  portENTER_CRITICAL(&error_sample_lock_);
+  uint32_t total = error_sample_count_;
+  if (total == 0) {
+    portEXIT_CRITICAL(&error_sample_lock_);
+    return 100;
+  }
+
+  const ErrorSample& latest = error_samples_[(total - 1) % kErrorSampleSlots];
+  uint8_t state = latest.state;
+  uint8_t worst_counter = latest.tx_error_counter > latest.rx_error_counter
+                              ? latest.tx_error_counter
+                              : latest.rx_error_counter;
+
+  size_t window = total < kHealthWindowSamples ? total : kHealthWindowSamples;
+  uint32_t errors = 0;
+  for (size_t i = 0; i < window; i++) {
+    const ErrorSample& sample = error_samples_[(total - 1 - i) % kErrorSampleSlots];
+    errors += sample.bus_errors + sample.tx_failed + sample.rx_lost;
+  }
+  portEXIT_CRITICAL(&error_sample_lock_);
+
+  if (state == TWAI_STATE_BUS_OFF || state == TWAI_STATE_RECOVERING) return 0;
+
+  // Error counters cost up to 60 points, recent error events up to 40
+  int32_t score = 100 - (worst_counter * 60) / 256;
+  score -= errors > 40 ? 40 : static_cast<int32_t>(errors);
+  if (worst_counter > 127 && score > 25) score = 25;  // Error passive
+  return static_cast<uint8_t>(score < 0 ? 0 : score);
+}
+#endif  // WAVESHARE_CAN_ERROR_SAMPLER
+
+WaveshareCan::TaskStats WaveshareCan::GetTaskStats() const {
+  TaskStats stats = {};
+  stats.rx = GetTaskHealth(rx_task_handle_, rx_stack_words_, rx_task_start_us_,
+                           &rx_run_time_);
+  stats.alert = GetTaskHealth(alert_task_handle_, alert_stack_words_,
+                              alert_task_start_us_, &alert_run_time_);
+  stats.tx = GetTaskHealth(tx_task_handle_, tx_stack_words_, tx_task_start_us_,
+                           &tx_run_time_);
+
+  stats.rx_stack_free = stats.rx.stack_free;
+  stats.alert_stack_free = stats.alert.stack_free;
+  stats.rx_stack_size = stats.rx.stack_size;
+  stats.alert_stack_size = stats.alert.stack_size;
+
+  stats.rx_queue_depth = RxQueueDepth();
+  stats.tx_queue_depth = tx_queue_.Size();
+  stats.rx_queue_high_water = rx_queue_high_water_;
+  stats.tx_queue_high_water = tx_queue_high_water_;
+
+  stats.rx_callback_max_us = rx_cb_max_us_;
+  stats.rx_callback_avg_us = rx_cb_calls_ ? rx_cb_total_us_ / rx_cb_calls_ : 0;
+  stats.alert_callback_max_us = alert_cb_max_us_;
+  stats.alert_callback_avg_us =
+      alert_cb_calls_ ? alert_cb_total_us_ / alert_cb_calls_ : 0;
+
+  stats.rx_callback_overruns = rx_cb_overruns_;
+  stats.alert_callback_overruns = alert_cb_overruns_;
+  stats.rx_stalls = rx_stall_count_;
+
+  stats.rx_stack_low = rx_stack_low_;
   return stats;
 }
 
+WaveshareCan::TaskHealth WaveshareCan::GetTaskHealth(TaskHandle_t handle,
+                                                     uint32_t stack_words,
+                                                     int64_t start_us,
+                                                     RunTimeTotal* run_time) const {
+  TaskHealth health = {};
+  health.stack_size = stack_words * 4;  // Convert words to bytes
+  if (handle == nullptr) return health;
+
+  health.stack_free = uxTaskGetStackHighWaterMark(handle);
+
+  // Measured peak plus 25% and 256 words headroom, rounded up to 256 words
+  uint32_t used = stack_words > health.stack_free ? stack_words - health.stack_free : 0;
+  uint32_t recommended = used + used / 4 + 256;
+  health.recommended_stack = (recommended + 255) & ~255u;
+
+#if configGENERATE_RUN_TIME_STATS
+  // ESP-IDF run-time counter ticks in microseconds (esp_timer) and is 32
+  // bits wide, so it wraps every ~71 minutes. Add the unsigned delta since
+  // the last call to a 64-bit total; correct as long as calls are less
+  // than one wrap apart.
+  TaskStatus_t status;
+  vTaskGetInfo(handle, &status, pdFALSE, eInvalid);
+  uint32_t counter = static_cast<uint32_t>(status.ulRunTimeCounter);
+  portENTER_CRITICAL(&run_time_lock_);
+  run_time->total_us += counter - run_time->last_counter;
+  run_time->last_counter = counter;
+  health.cpu_time_us = run_time->total_us;
+  portEXIT_CRITICAL(&run_time_lock_);
+  int64_t lifetime = esp_timer_get_time() - start_us;
+  if (lifetime > 0) {
+    uint64_t percent = health.cpu_time_us * 100 / static_cast<uint64_t>(lifetime);
+    health.cpu_percent = percent > 100 ? 100 : static_cast<uint8_t>(percent);
+  }
+#else
+  (void)start_us;
+  (void)run_time;
+#endif
+
+  return health;
+}
+
+void WAVESHARE_CAN_HOT WaveshareCan::RecordCallbackTime(uint32_t elapsed_us, bool alert) {
+  if (alert) {
+    if (elapsed_us > alert_cb_max_us_) alert_cb_max_us_ = elapsed_us;
+    alert_cb_total_us_ += elapsed_us;
+    alert_cb_calls_++;
+    if (elapsed_us > callback_budget_us_) alert_cb_overruns_++;
+  } else {
+    if (elapsed_us > rx_cb_max_us_) rx_cb_max_us_ = elapsed_us;
+    rx_cb_total_us_ += elapsed_us;
+    rx_cb_calls_++;
+    if (elapsed_us > callback_budget_us_) rx_cb_overruns_++;
+  }
+}
+
+void WaveshareCan::SetCallbackBudget(uint32_t budget_us) {
+  callback_budget_us_ = budget_us;
+}
+
+void WaveshareCan::SetRxWatchdog(uint32_t stall_ms) {
+  portENTER_CRITICAL(&watchdog_lock_);
+  rx_watchdog_ms_ = stall_ms;
+  watchdog_last_progress_ = rx_progress_;
+  watchdog_last_change_us_ = esp_timer_get_time();
+  rx_stalled_ = false;
+  portEXIT_CRITICAL(&watchdog_lock_);
+}
+
+bool WaveshareCan::CheckRxWatchdog() {
+  if (rx_watchdog_ms_ == 0 || !rx_interrupt_enabled_ || !initialized_) {
+    return false;
+  }
+
+  int64_t now = esp_timer_get_time();
+  uint32_t progress = rx_progress_;
+  bool stalled;
+
+  portENTER_CRITICAL(&watchdog_lock_);
+  if (progress != watchdog_last_progress_) {
+    watchdog_last_progress_ = progress;
+    watchdog_last_change_us_ = now;
+    rx_stalled_ = false;
+  }
+  bool overdue = (now - watchdog_last_change_us_) >=
+                 static_cast<int64_t>(rx_watchdog_ms_) * 1000;
+  stalled = rx_stalled_;
+  portEXIT_CRITICAL(&watchdog_lock_);
+
+  if (!overdue || stalled) return stalled;
+
+  // No progress for too long - only a stall if frames are piling up
+  twai_status_info_t status;
+  if (!ReadStatus(&status, status_max_age_us_) || status.msgs_to_rx == 0) {
+    return false;
+  }
+
+  portENTER_CRITICAL(&watchdog_lock_);
+  if (!rx_stalled_ && progress == watchdog_last_progress_) {
+    rx_stalled_ = true;
+    rx_stall_count_++;  // Counted once per stall episode
+  }
+  stalled = rx_stalled_;
+  portEXIT_CRITICAL(&watchdog_lock_);
+  return stalled;
+}
+
+void WaveshareCan::SetTaskStackSizes(uint32_t rx_words, uint32_t alert_words,
+                                     uint32_t tx_words) {
+  if (rx_words) rx_stack_words_ = rx_words;
+  if (alert_words) alert_stack_words_ = alert_words;
+  if (tx_words) tx_stack_words_ = tx_words;
+}
+
 void WaveshareCan::ResetCounters() {
   rx_dropped_count_ = 0;
+#if WAVESHARE_CAN_RX_PRIORITY
+  rx_priority_dropped_count_ = 0;
+#endif
+  rx_id_rejected_count_ = 0;
+#if WAVESHARE_CAN_FILTER_PROGRAM
+  rx_program_rejected_count_ = 0;
+#endif
+#if WAVESHARE_CAN_RTR_RESPONDER
+  rtr_answered_count_ = 0;
+  rtr_failed_count_ = 0;
+#endif
+#if WAVESHARE_CAN_RULES
+  for (size_t i = 0; i < kMaxRules; i++) rule_stats_[i] = CanRuleStats();
+#endif
+#if WAVESHARE_CAN_SHARED_RX
+  frame_pool_.ResetExhaustedCount();
+  for (size_t i = 0; i < kMaxRxSubscribers; i++) rx_subscriber_drops_[i] = 0;
+#endif
   tx_failed_count_ = 0;
+  tx_throttled_count_ = 0;
+  tx_expired_count_ = 0;
+  tx_late_count_ = 0;
+  tx_overwritten_count_ = 0;
+  rx_stack_low_ = false;
+  rx_queue_high_water_ = 0;
+  tx_queue_high_water_ = 0;
+  rx_cb_max_us_ = 0;
+  rx_cb_calls_ = 0;
+  rx_cb_total_us_ = 0;
+  alert_cb_max_us_ = 0;
+  alert_cb_calls_ = 0;
+  alert_cb_total_us_ = 0;
+  rx_cb_overruns_ = 0;
+  alert_cb_overruns_ = 0;
+  rx_stall_count_ = 0;
 }
\ No newline at end of file
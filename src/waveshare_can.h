@@ -3,8 +3,23 @@
 #define PROJECT_WAVESHARE_CAN_H_
 
 #include <Arduino.h>
+#include <atomic>
 #include "driver/twai.h"
+#include "esp_timer.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "can_filter_program.h"
+#include "can_frame_pool.h"
+#include "can_id_set.h"
+#include "can_mpsc_queue.h"
+#include "can_ring_buffer.h"
+#include "can_rules.h"
+#include "sdkconfig.h"
+#include "waveshare_can_attrs.h"
+#include "waveshare_can_policies.h"
+#if WAVESHARE_CAN_LOW_LEVEL
+#include "twai_register_backend.h"
+#endif
 
 // Board variants
 enum BoardType {
@@ -24,6 +39,56 @@ constexpr twai_timing_config_t kCan500Kbps  = TWAI_TIMING_CONFIG_500KBITS();
 constexpr twai_timing_config_t kCan800Kbps  = TWAI_TIMING_CONFIG_800KBITS();
 constexpr twai_timing_config_t kCan1000Kbps = TWAI_TIMING_CONFIG_1MBITS();
 
+// What happens to a frame that exceeds its transmit rate limit
+enum RateLimitAction {
+  kRateLimitReject,  // Drop it - SendMessage() returns false
+  kRateLimitQueue    // Hold it until tokens are available
+};
+
+// RX callback delivery mode (see WaveshareCan::SetRxBatching)
+enum RxBatchMode {
+  kRxBatchOff,       // One callback per frame (default)
+  kRxBatchAlways,    // Always deliver in batches
+  kRxBatchAdaptive   // Per-frame at low load, batches at high load
+};
+
+// Plain CAN frame used by the frame/batch transmit APIs
+struct CanFrame {
+  uint32_t id;
+  bool extended;
+  bool rtr;
+  uint8_t length;
+  uint8_t data[8];
+  bool single_shot;      // No automatic retransmission on error/arb loss
+  bool self_rx;          // Also receive our own frame (loopback/latency tests)
+  uint32_t deadline_us;  // Discard if not sent within this time (0 = none)
+};
+
+// Prebuilt frame for periodic messages (see WaveshareCan::MakeTxHandle).
+// ID, flags and DLC are packed once; only the payload changes between
+// sends, and Send() copies the message as-is without re-validating it.
+struct CanTxHandle {
+  twai_message_t message;
+  uint32_t deadline_us;  // Relative deadline applied on each Send() (0 = none)
+
+  void SetPayload(const uint8_t* data) {
+    memcpy(message.data, data, message.data_length_code);
+  }
+
+  void SetByte(uint8_t index, uint8_t value) { message.data[index & 7] = value; }
+
+  // Little-endian (Intel) signal: `length` bits starting at bit `start_bit`
+  // of the payload (bit 0 = LSB of data[0]). start_bit must be < 64.
+  void SetSignal(uint8_t start_bit, uint8_t length, uint64_t value) {
+    uint64_t raw;
+    memcpy(&raw, message.data, sizeof(raw));  // Xtensa is little-endian
+    uint64_t mask = (length >= 64) ? ~0ULL : ((1ULL << length) - 1);
+    mask <<= start_bit;
+    raw = (raw & ~mask) | ((value << start_bit) & mask);
+    memcpy(message.data, &raw, sizeof(raw));
+  }
+};
+
 class WaveshareCan {
  public:
   WaveshareCan(BoardType board = kBoard43b, int rx_pin = -1, int tx_pin = -1);
@@ -35,6 +100,29 @@ class WaveshareCan {
   // Start CAN with selected speed (default 500 kbps)
   bool Begin(twai_timing_config_t speed_config = kCan500Kbps);
 
+#if WAVESHARE_CAN_LOW_LEVEL
+  // Start CAN on the register-level backend instead of the IDF driver.
+  // The TWAI interrupt copies frames from the controller straight into the
+  // library's RX ring (see twai_register_backend.h) and runs isr_filter on
+  // each one first - return false there to drop a frame in the ISR.
+  // isr_filter runs in interrupt context: no blocking, no Serial, and
+  // IRAM_ATTR when built with WAVESHARE_CAN_IRAM_HOT_PATH.
+  // Receive, transmit, status and RX/TX tasks work as with Begin(); alerts
+  // (OnAlert, ProcessAlerts, EnableAlertInterrupt) are not available.
+  // Bus-off recovery is started by the interrupt itself.
+  bool BeginLowLevel(twai_timing_config_t speed_config = kCan500Kbps,
+                     TwaiIsrFilter isr_filter = nullptr,
+                     void* isr_arg = nullptr);
+
+  // True while running on the register-level backend
+  bool IsLowLevel() const { return initialized_ && low_level_; }
+
+  // Frames rejected by the BeginLowLevel() ISR filter
+  uint32_t GetIsrFilteredCount() const {
+    return ll_backend_.GetFilteredCount();
+  }
+#endif  // WAVESHARE_CAN_LOW_LEVEL
+
   // Stop and uninstall driver
   void End();
 
@@ -48,6 +136,67 @@ class WaveshareCan {
   // Simple version (standard ID, no RTR)
   bool SendMessage(uint32_t id, uint8_t* data, uint8_t length);
 
+  // Send one frame. Honors CanFrame::deadline_us and single_shot: a frame
+  // whose deadline passes before it reaches the controller is discarded.
+  bool SendFrame(const CanFrame& frame, uint32_t timeout_ms = 1000);
+
+  // Build a reusable handle once (length clamped to 8, payload zeroed)
+  static CanTxHandle MakeTxHandle(uint32_t id, bool extended, uint8_t length,
+                                  bool rtr = false, bool single_shot = false);
+  static CanTxHandle MakeTxHandle(const CanFrame& frame);
+
+  // Send the handle's current payload. Cheapest way to transmit a frame:
+  // no message construction, flag packing or argument checks per call.
+  bool Send(const CanTxHandle& handle, uint32_t timeout_ms = 1000);
+
+  // Send a block of frames back-to-back. Frames are handed to the driver TX
+  // queue as soon as a slot frees up, so the controller never idles between
+  // frames. Stops at the first failure or when timeout_ms expires.
+  // Returns the number of frames queued for transmission.
+  size_t SendBatch(const CanFrame* frames, size_t count,
+                   uint32_t timeout_ms = 1000);
+
+  // Enable software TX queue (starts background TX task). SendMessage() and
+  // SendBatch() then only enqueue; the TX task owns twai_transmit().
+  bool EnableTxQueue(uint16_t depth = 32);
+
+  // Disable TX queue and stop background task (pending frames are lost)
+  void DisableTxQueue();
+
+  // Get number of frames waiting in the software TX queue
+  int QueuedTxMessages();
+
+  // Limit total transmit bandwidth to a share of the bus (0 = unlimited).
+  // burst_frames: how many max-length frames may go out back-to-back.
+  void SetBusLoadBudget(uint8_t percent, uint16_t burst_frames = 8);
+
+  // Limit one ID to frames_per_sec (0 = remove limit). Returns false if
+  // the per-ID table (kMaxIdRateLimits entries) is full.
+  bool SetIdRateLimit(uint32_t id, bool extended, uint32_t frames_per_sec,
+                      uint16_t burst = 1);
+
+  // Reject throttled frames (default) or hold them until tokens are
+  // available - in the TX queue if enabled, otherwise by delaying the caller
+  // up to its TX timeout. In the TX queue a frame held by its per-ID limit
+  // is parked in one of kTxParkSlots side slots so other IDs keep flowing;
+  // only when all slots are taken does the queue wait for one to free.
+  void SetRateLimitAction(RateLimitAction action);
+
+  // Latest-value TX mailbox for an ID (requires TX queue). While a frame for
+  // this ID is still waiting in the TX queue, a new send overwrites it in
+  // place instead of queueing another one - only the freshest value goes out.
+  // Returns false if all kMaxTxMailboxes slots are taken.
+  bool AddTxMailbox(uint32_t id, bool extended = false);
+
+  // Remove all mailboxes (frames still waiting in a mailbox are dropped)
+  void ClearTxMailboxes();
+
+  // Nominal bitrate of the active timing config (bits/s)
+  uint32_t GetBitrate() const;
+
+  // Worst-case on-wire length of a frame in bits (incl. stuff bits and IFS)
+  static uint32_t FrameBits(bool extended, uint8_t length, bool rtr = false);
+
   // Receive one message (non-blocking, returns bytes read or -1)
   int ReceiveMessage(uint32_t* id, bool* extended, uint8_t* data,
                      uint8_t* length, bool* rtr = nullptr);
@@ -55,9 +204,93 @@ class WaveshareCan {
   // Set acceptance filter (re-initializes driver)
   bool Filter(uint32_t id, uint32_t mask = 0, bool extended = false);
 
-  // Get TWAI status
+  // Set a raw acceptance filter config, e.g. CanIdSet::FilterConfig()
+  bool Filter(const twai_filter_config_t& config);
+
+  // Software ID check in the RX task: frames not in the set are dropped
+  // before callbacks and queues (two hashes + compare per frame). The set's
+  // table must outlive the lookup. Configure before EnableRxInterrupt().
+  void SetRxIdSet(const CanIdLookup& lookup);
+  void ClearRxIdSet();
+
+#if __cplusplus >= 201402L
+  // Hardware filter and RX task check from one compile-time ID set (C++14)
+  template <size_t N>
+  bool UseIdSet(const CanIdSet<N>& set) {
+    if (!set.Valid()) return false;
+    SetRxIdSet(set.View());
+    if (!initialized_) {
+      filter_config_ = set.FilterConfig();  // Applied by the next Begin()
+      return true;
+    }
+    return Filter(set.FilterConfig());
+  }
+#endif
+
+  // Frames the hardware filter let through but the RX ID set rejected
+  uint32_t GetIdSetRejectedCount() const { return rx_id_rejected_count_; }
+
+#if WAVESHARE_CAN_FILTER_PROGRAM
+  // Bytecode filter run in the RX task after the ID set, e.g.
+  // "dlc == 8 && data[0] in 0x10..0x1F" (syntax: can_filter_program.h).
+  // Rejected frames are dropped before callbacks and queues. Returns false
+  // if the expression does not compile. Configure before EnableRxInterrupt().
+  bool SetRxFilterProgram(const char* expression);
+  bool SetRxFilterProgram(const CanFilterProgram& program);
+  void ClearRxFilterProgram();
+
+  // Frames dropped by the RX filter program
+  uint32_t GetFilterProgramRejectedCount() const {
+    return rx_program_rejected_count_;
+  }
+#endif  // WAVESHARE_CAN_FILTER_PROGRAM
+
+#if WAVESHARE_CAN_RULES
+  // Reactive rules (see can_rules.h). Checked in the RX task on every frame,
+  // ahead of the ID set and filter program, so application filters never
+  // hide an interlock. Actions run right there: GPIO first, then the TX
+  // frame is submitted without waiting (via the TX queue when enabled).
+  // Returns the rule index, or -1 if the table is full or the GPIO is not
+  // an output pin. Configure before EnableRxInterrupt().
+  static constexpr size_t kMaxRules = 16;
+  int AddRule(const CanRule& rule);
+  void ClearRules();
+
+  // Counters and reaction latency for one rule (reset by ResetCounters)
+  bool GetRuleStats(int index, CanRuleStats* stats) const;
+#endif  // WAVESHARE_CAN_RULES
+
+#if WAVESHARE_CAN_RTR_RESPONDER
+  // RTR auto-responder: a remote frame for a registered ID is answered from
+  // the RX task with the entry's current payload (submitted without waiting,
+  // via the TX queue when enabled). The request is still delivered as usual.
+  // Calling again for the same ID updates the payload atomically - safe from
+  // any task while the RX task runs (seqlock per entry). Returns false if
+  // all kMaxRtrResponses entries are taken or length > 8.
+  static constexpr size_t kMaxRtrResponses = 8;
+  bool SetRtrResponse(uint32_t id, bool extended, const uint8_t* data,
+                      uint8_t length);
+  void ClearRtrResponses();
+
+  // Remote frames answered / replies the TX path did not accept
+  uint32_t GetRtrAnsweredCount() const { return rtr_answered_count_; }
+  uint32_t GetRtrFailedCount() const { return rtr_failed_count_; }
+#endif  // WAVESHARE_CAN_RTR_RESPONDER
+
+  // Get TWAI status (served from the status cache when enabled)
   bool GetStatus(twai_status_info_t* status);
 
+  // Status cache. twai_get_status_info() enters a driver critical section on
+  // every call; with a max age > 0, Available(), GetStatus() and internal
+  // monitoring reuse a snapshot that is at most max_age_us old. The alert
+  // task, RX task and error sampler keep it fresh in the background.
+  // 0 = always query the driver (default).
+  void SetStatusCacheMaxAge(uint32_t max_age_us);
+
+  // Latest cached snapshot without touching the driver (lock-free).
+  // Returns false if no snapshot has been taken yet.
+  bool GetCachedStatus(twai_status_info_t* status, uint32_t* age_us = nullptr);
+
   // Switch between normal and listen-only mode
   bool SetListenOnly(bool listen_only);
 
@@ -70,7 +303,52 @@ class WaveshareCan {
   // Keep execution time < 1ms. NO blocking calls, Serial.print, or allocations.
   void OnAlert(void (*callback)(uint32_t));
 
-  // Enable interrupt-driven alert handling (starts background task)
+  // Alerts enabled by default. TX_IDLE, TX_SUCCESS and RX_DATA fire on every
+  // frame - drop them from the mask if you don't need them.
+  static constexpr uint32_t kDefaultAlertMask =
+      TWAI_ALERT_RX_DATA | TWAI_ALERT_TX_IDLE | TWAI_ALERT_TX_SUCCESS |
+      TWAI_ALERT_TX_FAILED | TWAI_ALERT_ERR_PASS | TWAI_ALERT_BUS_ERROR |
+      TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED;
+
+  // Choose which alerts reach the callback. The driver additionally keeps
+  // BUS_OFF (auto recovery) and whatever enabled features need, but those
+  // are filtered out before the callback if not in the mask.
+  bool SetAlertMask(uint32_t mask);
+  uint32_t GetAlertMask() const { return alert_mask_; }
+
+  // Coalesce alerts: the callback receives the accumulated bitmask at most
+  // once per interval_us (0 = every alert, default). BUS_OFF is always
+  // delivered immediately.
+  void SetAlertCoalescing(uint32_t interval_us);
+
+  // Alert storm protection: invoke the callback at most callbacks_per_sec
+  // times (0 = unlimited, default). Alerts arriving meanwhile are ORed into
+  // the next invocation, so nothing is lost - only the call rate drops.
+  // BUS_OFF is always delivered immediately.
+  void SetAlertRateLimit(uint32_t callbacks_per_sec, uint16_t burst = 4);
+
+  // Alert statistics
+  static constexpr size_t kAlertTypes = 17;        // TWAI_ALERT_* bits
+  static constexpr size_t kAlertRateSeconds = 60;  // Rate timeline length
+  static constexpr size_t kAlertRateBuckets = 12;
+
+  struct AlertStats {
+    uint32_t count[kAlertTypes];  // Per alert type, index = bit position
+    uint32_t callbacks;           // Callback invocations
+    uint32_t suppressed;          // Alert reads held back by the rate limit
+    uint32_t coalesced;           // Alert reads merged by coalescing
+    uint32_t log_suppressed;      // ProcessAlerts() log lines not printed
+    uint16_t per_second[kAlertRateSeconds];  // Alerts/s, last 60 s, oldest first
+    // Seconds since reset by alert rate, bucket i = fewer than 2^(i+1)
+    // alerts in that second (last bucket also holds all higher rates)
+    uint32_t rate_histogram[kAlertRateBuckets];
+  };
+
+  bool GetAlertStats(AlertStats* stats);
+  void ResetAlertStats();
+
+  // Enable interrupt-driven alert handling (starts background task). The
+  // task also starts bus-off recovery, so ProcessAlerts() is not needed.
   bool EnableAlertInterrupt(void (*callback)(uint32_t) = nullptr);
 
   // Disable alert interrupt and stop background task
@@ -93,9 +371,36 @@ class WaveshareCan {
   // For heavy processing, use ReceiveFromQueue() in main loop instead.
   void OnReceive(void (*callback)(const twai_message_t& msg));
 
+  // Set callback receiving a span of frames. Same rules as OnReceive().
+  // In batched delivery it replaces the per-frame callback; in per-frame
+  // delivery it is called with count 1 when no OnReceive() callback is set.
+  void OnReceiveBatch(void (*callback)(const twai_message_t* msgs,
+                                       size_t count));
+
+#if WAVESHARE_CAN_RX_BATCHING
+  // Batched delivery: collect up to max_frames or max_delay_us (1 tick
+  // granularity), whichever comes first. Adaptive mode switches to batches
+  // above rate_threshold frames/s and back below half of it.
+  void SetRxBatching(RxBatchMode mode, uint16_t max_frames = 16,
+                     uint32_t max_delay_us = 1000,
+                     uint32_t rate_threshold = 2000);
+
+  // True while the RX task is delivering in batches
+  bool IsRxBatching() const { return rx_batching_; }
+#endif  // WAVESHARE_CAN_RX_BATCHING
+
   // Enable interrupt-driven RX handling (starts background task)
   bool EnableRxInterrupt(void (*callback)(const twai_message_t& msg) = nullptr);
 
+  // Busy-poll RX: like EnableRxInterrupt(), but the RX task is pinned to
+  // `core` and spins on twai_receive() without ever blocking, trading a
+  // whole core for minimum wake-up latency and jitter. The idle-task
+  // watchdog of that core is disabled while polling. Use the core that is
+  // otherwise idle (Arduino loop() runs on core 1, WiFi on core 0).
+  // Stop with DisableRxInterrupt().
+  bool EnableRxBusyPoll(int core = 0,
+                        void (*callback)(const twai_message_t& msg) = nullptr);
+
   // Disable RX interrupt and stop background task
   void DisableRxInterrupt();
 
@@ -106,47 +411,571 @@ class WaveshareCan {
   int ReceiveFromQueue(uint32_t* id, bool* extended, uint8_t* data,
                        uint8_t* length, bool* rtr = nullptr);
 
+  // Zero-copy receive from the interrupt queue. BorrowRx() returns the
+  // oldest frame in place inside the RX ring (nullptr if empty);
+  // BorrowRxSpan() returns it plus the number of frames stored contiguously
+  // after it. Frames stay valid until ReleaseRx(n) consumes them.
+  // Spans never mix lanes; ReleaseRx() applies to the lane of the last
+  // borrow. One consumer task only - don't mix with ReceiveFromQueue()
+  // elsewhere.
+  const twai_message_t* BorrowRx();
+  const twai_message_t* BorrowRxSpan(size_t* count);
+  void ReleaseRx(size_t n = 1);
+
+#if WAVESHARE_CAN_RX_PRIORITY
+  // Dual-lane RX queue. The RX task sorts frames whose ID falls into a
+  // priority range into a small high-priority lane (16 frames), everything
+  // else into the bulk lane (64 frames). ReceiveFromQueue() and BorrowRx*()
+  // always drain the priority lane first, so a diagnostic burst cannot delay
+  // control frames. Returns false if all kMaxRxPriorityRanges are taken.
+  bool AddRxPriorityRange(uint32_t first_id, uint32_t last_id,
+                          bool extended = false);
+  void ClearRxPriorityRanges();
+
+  // Frames waiting in the high-priority lane (included in QueuedMessages())
+  int QueuedPriorityMessages();
+#endif  // WAVESHARE_CAN_RX_PRIORITY
+
+#if WAVESHARE_CAN_SHARED_RX
+  // Shared multi-consumer delivery. Each subscriber (logger, dispatcher,
+  // bridge, ...) gets its own queue of references into one frame pool: the
+  // RX task writes each frame once, all subscribers share it, and its slot
+  // returns to the pool when the last CanFrameRef drops. Subscribe before
+  // EnableRxInterrupt(). Returns the subscriber index, or -1 if all
+  // kMaxRxSubscribers are taken.
+  static constexpr size_t kMaxRxSubscribers = 4;
+  static constexpr size_t kFramePoolSlots = 32;
+  int AddRxSubscriber();
+
+  // Remove all subscribers (only while the RX task is stopped)
+  bool ClearRxSubscribers();
+
+  // Next frame for one subscriber (non-blocking). One task per subscriber.
+  bool ReceiveShared(int subscriber, CanFrameRef* frame);
+
+  struct FramePoolStats {
+    uint32_t slots;
+    uint32_t in_use;     // Slots still referenced by some subscriber
+    uint32_t exhausted;  // Frames not shared because the pool was full
+    uint32_t subscriber_drops[kMaxRxSubscribers];  // Subscriber queue full
+  };
+  FramePoolStats GetFramePoolStats() const;
+#endif  // WAVESHARE_CAN_SHARED_RX
+
   // Statistics and monitoring
+  struct TaskHealth {
+    uint32_t stack_free;         // Stack words never used (high-water mark)
+    uint32_t stack_size;         // Total stack size in bytes
+    uint32_t recommended_stack;  // Suggested stack size in words (0 = not running)
+    uint64_t cpu_time_us;        // Run time (0 without FreeRTOS run-time stats)
+    uint8_t cpu_percent;         // Share of one core since the task started
+  };
+
   struct TaskStats {
     uint32_t rx_stack_free;      // Stack words remaining for RX task
     uint32_t alert_stack_free;   // Stack words remaining for Alert task
     uint32_t rx_stack_size;      // Total RX task stack size in bytes
     uint32_t alert_stack_size;   // Total Alert task stack size in bytes
+
+    TaskHealth rx;
+    TaskHealth alert;
+    TaskHealth tx;
+
+    uint32_t rx_queue_depth;         // Frames waiting now (both lanes)
+    uint32_t rx_queue_high_water;    // Most frames ever waiting (both lanes)
+    uint32_t tx_queue_depth;
+    uint32_t tx_queue_high_water;
+
+    uint32_t rx_callback_max_us;     // Slowest OnReceive() callback
+    uint32_t rx_callback_avg_us;
+    uint32_t alert_callback_max_us;  // Slowest OnAlert() callback
+    uint32_t alert_callback_avg_us;
+
+    uint32_t rx_callback_overruns;     // RX callbacks over the time budget
+    uint32_t alert_callback_overruns;  // Alert callbacks over the time budget
+    uint32_t rx_stalls;                // RX watchdog detections
+
+    bool rx_stack_low;  // RX task dropped below kStackLowWords at some point
   };
 
+  // Time budget for OnReceive()/OnAlert() callbacks (default 1000 us).
+  // Every invocation is timed; slower ones count as overruns.
+  void SetCallbackBudget(uint32_t budget_us);
+
+  // RX watchdog: the RX task is considered stalled when it made no progress
+  // for stall_ms while frames are pending in the driver (0 = off, default).
+  // Checked by the alert task, ProcessAlerts() and the error sampler.
+  void SetRxWatchdog(uint32_t stall_ms);
+
+  // Run the watchdog check now, returns true while the RX task is stalled
+  bool CheckRxWatchdog();
+
+  // Override task stack sizes in words (0 = keep current). Applies the next
+  // time the task is started - use TaskHealth::recommended_stack as a guide.
+  void SetTaskStackSizes(uint32_t rx_words, uint32_t alert_words,
+                         uint32_t tx_words = 0);
+
+  // CPU times are 64-bit totals of FreeRTOS's 32-bit run-time counter,
+  // which wraps every ~71 minutes; call this at least that often.
   TaskStats GetTaskStats() const;
+
+#if WAVESHARE_CAN_TX_LATENCY
+  // TX latency per ID. Timestamps are taken at enqueue (SendMessage/
+  // SendFrame/SendBatch entry), at handoff to the driver and when the
+  // TX_SUCCESS alert is processed (alert task or ProcessAlerts()).
+  static constexpr size_t kTxLatencyBuckets = 16;
+  static constexpr size_t kMaxTxLatencyIds = 16;  // Power of two
+
+  struct TxLatencyStats {
+    uint32_t id;
+    bool extended;
+    uint32_t frames;          // Completed transmissions
+    uint32_t arb_lost;        // Arbitration losses while at head of line
+    uint32_t queue_us_max;    // Enqueue -> driver handoff
+    uint32_t total_us_max;    // Enqueue -> TX_SUCCESS
+    uint64_t total_us_sum;    // For the mean: total_us_sum / frames
+    // Enqueue -> TX_SUCCESS, bucket i counts latencies < 2^(i+1) us
+    // (last bucket also holds everything longer)
+    uint32_t histogram[kTxLatencyBuckets];
+  };
+
+  // Start/stop latency and arbitration-loss tracking (enables ARB_LOST alert)
+  bool EnableTxLatencyTracking(bool enable = true);
+
+  // Copy stats of all tracked IDs, returns number of entries written
+  size_t GetTxLatencySnapshot(TxLatencyStats* out, size_t max_entries);
+
+  void ResetTxLatencyStats();
+#endif  // WAVESHARE_CAN_TX_LATENCY
+
+#if WAVESHARE_CAN_ERROR_SAMPLER
+  // Error counter timeline. A periodic esp_timer samples TEC/REC, bus state
+  // and error counts into a fixed ring - no Serial, no allocation.
+  struct ErrorSample {
+    uint32_t time_ms;          // millis() at sample time
+    uint8_t state;             // twai_state_t
+    uint8_t tx_error_counter;  // TEC (saturates at 255)
+    uint8_t rx_error_counter;  // REC (saturates at 255)
+    uint16_t bus_errors;       // Bus errors since previous sample
+    uint16_t tx_failed;        // Failed transmissions since previous sample
+    uint16_t rx_lost;          // RX missed + overrun since previous sample
+  };
+
+  static constexpr size_t kErrorSampleSlots = 256;
+
+  // Start sampling every period_ms (runs until StopErrorSampler())
+  bool StartErrorSampler(uint32_t period_ms = 10);
+  void StopErrorSampler();
+
+  // Copy up to max_samples most recent samples, oldest first
+  size_t GetErrorSamples(ErrorSample* out, size_t max_samples);
+
+  // Bus health 0..100 from the latest samples: 100 = error free,
+  // <= 25 = error passive, 0 = bus-off
+  uint8_t GetBusHealthScore();
+#endif  // WAVESHARE_CAN_ERROR_SAMPLER
+
   uint32_t GetDroppedRxCount() const { return rx_dropped_count_; }
+#if WAVESHARE_CAN_RX_PRIORITY
+  uint32_t GetDroppedPriorityRxCount() const { return rx_priority_dropped_count_; }
+#endif
   uint32_t GetTxFailedCount() const { return tx_failed_count_; }
+  uint32_t GetThrottledCount() const { return tx_throttled_count_; }
+  uint32_t GetTxExpiredCount() const { return tx_expired_count_; }
+  uint32_t GetTxLateCount() const { return tx_late_count_; }
+  uint32_t GetTxOverwrittenCount() const { return tx_overwritten_count_; }
   void ResetCounters();
 
  private:
   void HandleAlerts(uint32_t alerts);
+  bool Restart();
+#if WAVESHARE_CAN_LOW_LEVEL
+  static void LowLevelIsr(void* arg);
+#endif
+  esp_err_t ReceiveFromController(twai_message_t* message, TickType_t wait);
+  esp_err_t TransmitToController(const twai_message_t& message,
+                                 TickType_t timeout);
+  esp_err_t ClearControllerTx();
   static void AlertTaskWrapper(void* arg);
   void AlertTask();
+  bool StartRxTask(void (*callback)(const twai_message_t& msg), int core);
   static void RxTaskWrapper(void* arg);
   void RxTask();
+  void DispatchRx(const twai_message_t& message);
+  void UpdateRxHighWater();
+  uint32_t RxQueueDepth() const;  // All RX lanes together
+#if WAVESHARE_CAN_SHARED_RX
+  void PublishShared(const twai_message_t& message);
+#endif
+#if WAVESHARE_CAN_RULES
+  void RunRules(const twai_message_t& message);
+#endif
+#if WAVESHARE_CAN_RTR_RESPONDER
+  void AnswerRtr(const twai_message_t& message);
+#endif
+#if WAVESHARE_CAN_RX_BATCHING
+  void FlushRxBatch();
+  void UpdateRxBatchMode(int64_t now_us);
+#endif
+  void InvokeBatchCallback(const twai_message_t* msgs, size_t count);
+  void RecordCallbackTime(uint32_t elapsed_us, bool alert);
+  // 64-bit total of a task's 32-bit FreeRTOS run-time counter
+  struct RunTimeTotal {
+    uint32_t last_counter;
+    uint64_t total_us;
+  };
+  TaskHealth GetTaskHealth(TaskHandle_t handle, uint32_t stack_words,
+                           int64_t start_us, RunTimeTotal* run_time) const;
+  static void TxTaskWrapper(void* arg);
+  void TxTask();
+  // Software TX queue entry
+  struct TxItem {
+    twai_message_t message;
+    int64_t deadline_us;  // Absolute esp_timer time (0 = none)
+    int16_t mailbox;      // Mailbox slot holding the frame (-1 = inline)
+    int64_t enqueue_us;   // Submission time, for latency tracking
+  };
+
+#if WAVESHARE_CAN_TX_LATENCY
+  // Frame handed to the driver and not yet confirmed by an alert
+  struct TxInFlight {
+    uint32_t key;
+    int64_t enqueue_us;
+    int64_t handoff_us;
+  };
+#endif  // WAVESHARE_CAN_TX_LATENCY
+
+  struct TxMailbox {
+    bool used;
+    bool pending;  // Queued and not yet taken by TxTask()
+    uint32_t key;
+    TxItem item;
+  };
+
+  static void BuildMessage(const CanFrame& frame, twai_message_t* message);
+  static int64_t AbsoluteDeadline(uint32_t deadline_us);
+  // quiet: never log (for RX-task callers - Serial there overflows the
+  // stack). Failures are counted either way, once, by HandOffToDriver().
+  bool SubmitFrame(const TxItem& item, TickType_t timeout, bool quiet = false);
+  bool SubmitToQueue(const TxItem& item, TickType_t timeout);
+  bool EnqueueTx(const TxItem& item, TickType_t timeout);
+  esp_err_t HandOffToDriver(const TxItem& item, TickType_t timeout);
+  void PurgeExpiredDriverTx();
+  uint32_t EnabledAlerts() const;
+  bool FetchStatus(twai_status_info_t* status);
+  bool ReadStatus(twai_status_info_t* status, uint32_t max_age_us);
+  void DeliverAlerts(uint32_t alerts);
+  bool FlushCoalescedAlerts(bool force, bool* rate_limited = nullptr);
+  void CountAlerts(uint32_t alerts);
+  void CloseAlertSeconds(int64_t now_sec);
+  void InvokeAlertCallback(uint32_t alerts);
+  void AddAlertStat(uint32_t* counter);
+#if WAVESHARE_CAN_ERROR_SAMPLER
+  static void ErrorSamplerCallback(void* arg);
+  void SampleErrors();
+#endif  // WAVESHARE_CAN_ERROR_SAMPLER
+#if WAVESHARE_CAN_TX_LATENCY
+  // done_us: when the frames finished (0 = now)
+  void TrackTxCompletions(uint32_t alerts, int64_t done_us = 0);
+#if WAVESHARE_CAN_LOW_LEVEL
+  void TrackLowLevelTx();
+#endif
+  TxLatencyStats* FindTxLatencyStats(uint32_t key);
+#endif
+  bool AcquireTxTokens(const twai_message_t& message, TickType_t max_wait,
+                       bool count_throttled = true);
+  bool IdTokensReady(uint32_t key);
+  bool ParkIfIdLimited(const TxItem& item);
+  void ServiceParkedTx();
+
+  // Token bucket. Tokens are scaled by 1e6 so refill is a plain
+  // elapsed_us * rate multiply (units: bits for the bus budget, frames
+  // for per-ID limits).
+  struct TokenBucket {
+    uint64_t tokens;
+    uint64_t capacity;
+    uint32_t rate;  // Units per second (0 = unlimited)
+    int64_t last_us;
+  };
+
+  struct IdRateLimit {
+    bool used;
+    uint32_t key;  // ID | kExtendedKeyFlag for 29-bit IDs
+    TokenBucket bucket;
+  };
+
+  static void ConfigureBucket(TokenBucket* bucket, uint32_t rate,
+                              uint32_t burst);
+  static int64_t BucketWaitUs(TokenBucket* bucket, uint32_t cost,
+                              int64_t now_us);
+  IdRateLimit* FindIdRateLimit(uint32_t key, bool insert);
+  int16_t FindTxMailbox(uint32_t key, bool insert);
+  bool TakeTxMailbox(TxItem* item);
+
+  static constexpr uint32_t kExtendedKeyFlag = 0x80000000;
+  static constexpr size_t kMaxIdRateLimits = 16;  // Power of two
+  static constexpr size_t kMaxTxMailboxes = 16;   // Power of two
+  static constexpr size_t kTxParkSlots = 4;       // Frames held by an ID limit
+
+  // Driver queue depths. A deep TX queue lets SendBatch() keep the
+  // controller busy while the caller is still refilling it.
+  static constexpr uint32_t kDriverTxQueueLen = 16;
+  static constexpr uint32_t kDriverRxQueueLen = 32;
+#if WAVESHARE_CAN_LOW_LEVEL
+  static constexpr size_t kLowLevelRingLen = 64;  // Power of two
+#endif
 
   // Task stack sizes (in WORDS for xTaskCreate)
   static constexpr uint32_t kRxTaskStackSize = 2048;     // 2048 words = 8KB
   static constexpr uint32_t kAlertTaskStackSize = 2048;  // 2048 words = 8KB (increased from 4KB)
+  static constexpr uint32_t kTxTaskStackSize = 2048;     // 2048 words = 8KB
+  static constexpr uint32_t kStackLowWords = 512;
+  static constexpr uint32_t kRxQueueLen = 64;          // Bulk lane
+#if WAVESHARE_CAN_RX_PRIORITY
+  static constexpr uint32_t kRxPriorityQueueLen = 16;  // High-priority lane
+  static constexpr size_t kMaxRxPriorityRanges = 4;
+#endif
+#if WAVESHARE_CAN_RX_BATCHING
+  static constexpr uint16_t kMaxRxBatch = 32;
+  static constexpr int64_t kRxRateWindowUs = 10000;
+#endif
 
   BoardType board_type_;
   int rx_pin_;
   int tx_pin_;
   bool initialized_;
+  bool low_level_;  // Register backend selected by the last BeginLowLevel()
   bool listen_only_;
   bool alert_interrupt_enabled_;
   bool rx_interrupt_enabled_;
+  int rx_busy_poll_core_;  // Core of the busy-poll RX task (-1 = blocking)
+  std::atomic<bool> tx_queue_enabled_;
   volatile bool shutdown_;  // Shutdown flag for clean task termination
   void (*alert_callback_)(uint32_t);
   void (*rx_callback_)(const twai_message_t&);
+  void (*rx_batch_callback_)(const twai_message_t*, size_t);
   TaskHandle_t alert_task_handle_;
   TaskHandle_t rx_task_handle_;
-  QueueHandle_t rx_queue_;
+  TaskHandle_t tx_task_handle_;
+  uint32_t rx_stack_words_;
+  uint32_t alert_stack_words_;
+  uint32_t tx_stack_words_;
+  int64_t rx_task_start_us_;
+  int64_t alert_task_start_us_;
+  int64_t tx_task_start_us_;
+  // Updated by GetTaskStats(); reset when the task starts
+  mutable RunTimeTotal rx_run_time_;
+  mutable RunTimeTotal alert_run_time_;
+  mutable RunTimeTotal tx_run_time_;
+  mutable portMUX_TYPE run_time_lock_ = portMUX_INITIALIZER_UNLOCKED;
+
+  // Software TX queue: any task produces, the TX task consumes. The TX
+  // task sets tx_task_waiting_ before sleeping; producers wake it.
+  // Producers count themselves in tx_producers_ before checking
+  // tx_queue_enabled_, so DisableTxQueue() can wait for them to leave
+  // before freeing the queue storage.
+  CanMpscQueue<TxItem> tx_queue_;
+  std::atomic<bool> tx_task_waiting_;
+  std::atomic<uint32_t> tx_producers_;
+  // Frames waiting for their per-ID tokens, oldest first (TX task only)
+  TxItem tx_parked_[kTxParkSlots];
+  size_t tx_parked_count_;
+
+  // Interrupt-mode RX rings: RX task produces, the application consumes.
+  // Priority ranges are published by bumping rx_priority_range_count_.
+  CanRingBuffer<twai_message_t, kRxQueueLen> rx_ring_;
+#if WAVESHARE_CAN_RX_PRIORITY
+  struct RxPriorityRange {
+    uint32_t first_key;  // ID | kExtendedKeyFlag for 29-bit IDs
+    uint32_t last_key;
+  };
+  CanRingBuffer<twai_message_t, kRxPriorityQueueLen> rx_priority_ring_;
+  RxPriorityRange rx_priority_ranges_[kMaxRxPriorityRanges];
+  volatile uint32_t rx_priority_range_count_;
+  bool rx_borrowed_priority_;  // Lane of the last BorrowRx*() (consumer only)
+#endif
+
+#if WAVESHARE_CAN_SHARED_RX
+  // Shared delivery: pool written by the RX task, one reference queue per
+  // subscriber
+  static constexpr size_t kRxSubscriberQueueLen = 16;
+  CanFramePool<kFramePoolSlots> frame_pool_;
+  CanRingBuffer<CanPooledFrame*, kRxSubscriberQueueLen>
+      rx_subscribers_[kMaxRxSubscribers];
+  volatile uint32_t rx_subscriber_count_;
+  volatile uint32_t rx_subscriber_drops_[kMaxRxSubscribers];
+#endif  // WAVESHARE_CAN_SHARED_RX
+
+  // Compile-time ID set checked by DispatchRx() (see SetRxIdSet)
+  CanIdLookup rx_id_set_;
+  volatile bool rx_id_set_active_;
+
+#if WAVESHARE_CAN_FILTER_PROGRAM
+  // Bytecode filter checked by DispatchRx() (see SetRxFilterProgram)
+  CanFilterProgram rx_program_;
+  volatile bool rx_program_active_;
+#endif  // WAVESHARE_CAN_FILTER_PROGRAM
+
+#if WAVESHARE_CAN_RULES
+  // Reactive rule table (see AddRule)
+  CanRule rules_[kMaxRules];
+  CanRuleStats rule_stats_[kMaxRules];
+  volatile uint32_t rule_count_;
+#endif  // WAVESHARE_CAN_RULES
+
+#if WAVESHARE_CAN_RTR_RESPONDER
+  // RTR auto-responder - entries are appended under rtr_lock_ and published
+  // by rtr_response_count_; payload updates use the per-entry seqlock
+  struct RtrResponse {
+    uint32_t key;               // ID | kExtendedKeyFlag for 29-bit IDs
+    std::atomic<uint32_t> seq;  // Odd while the payload is being written
+    uint8_t length;
+    uint8_t data[TWAI_FRAME_MAX_DLC];
+  };
+  portMUX_TYPE rtr_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  RtrResponse rtr_responses_[kMaxRtrResponses];
+  volatile uint32_t rtr_response_count_;
+#endif  // WAVESHARE_CAN_RTR_RESPONDER
+
+#if WAVESHARE_CAN_LOW_LEVEL
+  // Register-level backend (BeginLowLevel)
+  TwaiRegisterBackend<TwaiMmio, kLowLevelRingLen> ll_backend_;
+  TwaiIsrFilter ll_isr_filter_;
+  void* ll_isr_arg_;
+  intr_handle_t ll_intr_;
+  SemaphoreHandle_t ll_tx_done_;  // Given by the ISR when the TX buffer frees
+  portMUX_TYPE ll_tx_lock_ = portMUX_INITIALIZER_UNLOCKED;  // TX buffer
+  int64_t ll_tx_done_us_;  // Last TX interrupt (guarded by ll_tx_lock_)
+#endif  // WAVESHARE_CAN_LOW_LEVEL
+
+  // Transmit rate limiting (guarded by tx_limit_lock_)
+  portMUX_TYPE tx_limit_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  RateLimitAction rate_limit_action_;
+  uint8_t bus_load_percent_;
+  uint16_t bus_load_burst_frames_;
+  TokenBucket bus_bucket_;
+  IdRateLimit id_limits_[kMaxIdRateLimits];
+  bool id_limits_active_;
+
+  // Latest-value mailboxes (guarded by tx_limit_lock_)
+  TxMailbox tx_mailboxes_[kMaxTxMailboxes];
+  bool tx_mailboxes_active_;
+
+#if WAVESHARE_CAN_TX_LATENCY
+  // TX latency tracking (guarded by tx_stats_lock_)
+  static constexpr size_t kTxInFlightSlots = 32;  // > driver TX queue + 1
+  portMUX_TYPE tx_stats_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  volatile bool tx_latency_enabled_;
+  TxInFlight tx_in_flight_[kTxInFlightSlots];
+  uint32_t tx_in_flight_head_;
+  uint32_t tx_in_flight_count_;
+  uint32_t tx_arb_lost_seen_;  // Last driver arb_lost_count
+  bool tx_latency_used_[kMaxTxLatencyIds];
+  TxLatencyStats tx_latency_[kMaxTxLatencyIds];
+#endif  // WAVESHARE_CAN_TX_LATENCY
+
+#if WAVESHARE_CAN_ERROR_SAMPLER
+  // Error counter sampler (ring guarded by error_sample_lock_)
+  static constexpr size_t kHealthWindowSamples = 64;
+  portMUX_TYPE error_sample_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  esp_timer_handle_t error_sampler_;
+  ErrorSample error_samples_[kErrorSampleSlots];
+  uint32_t error_sample_count_;  // Total samples taken (ring index = count % slots)
+  twai_status_info_t error_sample_prev_;
+#endif  // WAVESHARE_CAN_ERROR_SAMPLER
+
+  // Latest deadline among frames handed to the driver TX queue
+  // (0 = queue drained, -1 = holds a frame without deadline). Senders mark
+  // it before transmitting; PurgeExpiredDriverTx() flushes only while no
+  // hand-off is active and blocks new ones with tx_purging_. All guarded
+  // by tx_limit_lock_.
+  int64_t driver_tx_deadline_us_;
+  uint32_t tx_handoff_seq_;     // Bumped by every hand-off
+  uint32_t tx_handoffs_active_;
+  bool tx_purging_;
+
+  // Status cache - seqlock: writers serialize on status_cache_lock_ and
+  // make status_seq_ odd while copying, readers retry until it is stable
+  portMUX_TYPE status_cache_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  std::atomic<uint32_t> status_seq_;
+  twai_status_info_t status_cache_;
+  int64_t status_cache_us_;  // 0 = no snapshot
+  volatile uint32_t status_max_age_us_;
+
+  // Alert mask and coalescing (pending state owned by the alert consumer)
+  static constexpr uint32_t kUrgentAlerts = TWAI_ALERT_BUS_OFF;
+  volatile uint32_t alert_mask_;
+  volatile uint32_t alert_coalesce_us_;
+  uint32_t pending_alerts_;
+  int64_t last_alert_delivery_us_;
+  TokenBucket alert_rate_bucket_;   // Callback invocations
+  TokenBucket alert_log_bucket_;    // HandleAlerts() Serial lines
+
+  // Alert statistics (guarded by alert_stats_lock_)
+  static constexpr uint32_t kAlertLogPerSec = 5;
+  portMUX_TYPE alert_stats_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  AlertStats alert_stats_;
+  bool alert_stats_started_;       // alert_stats_second_ is valid
+  int64_t alert_stats_second_;     // Second currently being counted
+  uint32_t alert_stats_current_;   // Alerts in that second
+  uint32_t alert_stats_written_;   // Seconds written to the per_second ring
+
+#if WAVESHARE_CAN_RX_BATCHING
+  // Adaptive RX batching (RX task only, except the config fields)
+  volatile RxBatchMode rx_batch_mode_;
+  volatile uint16_t rx_batch_max_frames_;
+  volatile uint32_t rx_batch_max_delay_us_;
+  volatile uint32_t rx_batch_rate_threshold_;
+  volatile bool rx_batching_;
+  twai_message_t rx_batch_[kMaxRxBatch];
+  uint16_t rx_batch_count_;
+  int64_t rx_batch_start_us_;
+  uint32_t rx_window_frames_;
+  int64_t rx_window_start_us_;
+  uint32_t rx_rate_avg_;  // Frames/s, EWMA over 10 ms windows
+#endif  // WAVESHARE_CAN_RX_BATCHING
 
   // Statistics (volatile for thread-safety on single increments)
   volatile uint32_t rx_dropped_count_;
+#if WAVESHARE_CAN_RX_PRIORITY
+  volatile uint32_t rx_priority_dropped_count_;
+#endif
+  volatile uint32_t rx_id_rejected_count_;
+#if WAVESHARE_CAN_FILTER_PROGRAM
+  volatile uint32_t rx_program_rejected_count_;
+#endif
+#if WAVESHARE_CAN_RTR_RESPONDER
+  volatile uint32_t rtr_answered_count_;
+  volatile uint32_t rtr_failed_count_;
+#endif
   volatile uint32_t tx_failed_count_;
+  volatile uint32_t tx_throttled_count_;
+  volatile uint32_t tx_expired_count_;  // Discarded before reaching driver
+  volatile uint32_t tx_late_count_;     // Cleared from driver queue
+  volatile uint32_t tx_overwritten_count_;
+
+  // Task health
+  volatile bool rx_stack_low_;
+  volatile uint32_t rx_queue_high_water_;
+  volatile uint32_t tx_queue_high_water_;
+  volatile uint32_t rx_cb_max_us_;
+  volatile uint32_t rx_cb_calls_;
+  volatile uint64_t rx_cb_total_us_;
+  volatile uint32_t alert_cb_max_us_;
+  volatile uint32_t alert_cb_calls_;
+  volatile uint64_t alert_cb_total_us_;
+  volatile uint32_t callback_budget_us_;
+  volatile uint32_t rx_cb_overruns_;
+  volatile uint32_t alert_cb_overruns_;
+
+  // RX stall watchdog (guarded by watchdog_lock_)
+  portMUX_TYPE watchdog_lock_ = portMUX_INITIALIZER_UNLOCKED;
+  volatile uint32_t rx_progress_;  // Bumped on every RX task loop pass
+  uint32_t rx_watchdog_ms_;
+  uint32_t watchdog_last_progress_;
+  int64_t watchdog_last_change_us_;
+  bool rx_stalled_;
+  volatile uint32_t rx_stall_count_;
 
   twai_timing_config_t timing_config_;
   twai_filter_config_t filter_config_;
@@ -0,0 +1,20 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_WAVESHARE_CAN_ATTRS_H_
+#define PROJECT_WAVESHARE_CAN_ATTRS_H_
+
+// Build option: -DWAVESHARE_CAN_IRAM_HOT_PATH places the RX/TX hot path
+// (RX task, dispatch, queue push/pop, rate limiter, filters) in IRAM so it
+// keeps running through flash cache misses caused by PSRAM/LCD traffic.
+// Add CONFIG_TWAI_ISR_IN_IRAM=y to the sdkconfig to also keep the driver
+// ISR capturing frames while the cache is disabled for flash writes.
+//
+// Kept free of Arduino and driver headers so portable sources (filter
+// programs, rules) can mark their hot functions without pulling them in.
+#if defined(WAVESHARE_CAN_IRAM_HOT_PATH) && defined(ESP_PLATFORM)
+#include "esp_attr.h"
+#define WAVESHARE_CAN_HOT IRAM_ATTR
+#else
+#define WAVESHARE_CAN_HOT
+#endif
+
+#endif  // PROJECT_WAVESHARE_CAN_ATTRS_H_
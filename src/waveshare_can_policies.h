@@ -0,0 +1,108 @@
+// Copyright 2026 p43lz3r
+#ifndef PROJECT_WAVESHARE_CAN_POLICIES_H_
+#define PROJECT_WAVESHARE_CAN_POLICIES_H_
+
+#include <Arduino.h>
+
+// Build profiles. WaveshareCan reaches logging and statistics only through
+// the CanLog and CanStats policies below, so a policy that does nothing
+// compiles those paths out completely (format strings included).
+//
+//   -DWAVESHARE_CAN_MINIMAL              no logging, no drop/failure counters,
+//                                        optional features below off
+//   -DWAVESHARE_CAN_LOG_POLICY=CanLogNone    pick policies individually
+//   -DWAVESHARE_CAN_STATS_POLICY=CanStatsNone
+//
+// The code of tasks, alert handling and the RX/TX queues is only referenced
+// from their Enable*() calls, so the linker drops it from sketches that
+// never enable them; task stacks and the TX queue are allocated on enable.
+// Data members are different: the linker cannot remove them, so every
+// feature below costs its RAM inside each WaveshareCan object unless it is
+// switched off at compile time (-DWAVESHARE_CAN_RULES=0 etc.). A disabled
+// feature's API is removed along with its storage.
+
+// Logging policies
+struct CanLogSerial {
+  static void Println(const char* text) { Serial.println(text); }
+
+  template <typename... Args>
+  static void Printf(const char* format, Args... args) {
+    Serial.printf(format, args...);
+  }
+};
+
+struct CanLogNone {
+  static void Println(const char*) {}
+
+  template <typename... Args>
+  static void Printf(const char*, Args...) {}
+};
+
+// Statistics policies (drop/failure counters read by the Get*Count() calls)
+struct CanStatsFull {
+  static constexpr bool kEnabled = true;
+  static void Add(volatile uint32_t& counter, uint32_t n = 1) { counter += n; }
+};
+
+struct CanStatsNone {
+  static constexpr bool kEnabled = false;  // Counters always read 0
+  static void Add(volatile uint32_t&, uint32_t = 1) {}
+};
+
+#ifdef WAVESHARE_CAN_MINIMAL
+#ifndef WAVESHARE_CAN_LOG_POLICY
+#define WAVESHARE_CAN_LOG_POLICY CanLogNone
+#endif
+#ifndef WAVESHARE_CAN_STATS_POLICY
+#define WAVESHARE_CAN_STATS_POLICY CanStatsNone
+#endif
+#endif
+
+// Optional features (1 = on). Sizes are per WaveshareCan object, measured
+// as sizeof() in a 32-bit host build: ~15 KB with everything on, ~3.6 KB
+// under WAVESHARE_CAN_MINIMAL. Object size only; code size is not included.
+#ifdef WAVESHARE_CAN_MINIMAL
+#define WAVESHARE_CAN_FEATURE_DEFAULT 0
+#else
+#define WAVESHARE_CAN_FEATURE_DEFAULT 1
+#endif
+
+#ifndef WAVESHARE_CAN_ERROR_SAMPLER  // StartErrorSampler(), ~4.1 KB
+#define WAVESHARE_CAN_ERROR_SAMPLER WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_TX_LATENCY  // EnableTxLatencyTracking(), ~2.2 KB
+#define WAVESHARE_CAN_TX_LATENCY WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_LOW_LEVEL  // BeginLowLevel(), ~1.4 KB
+#define WAVESHARE_CAN_LOW_LEVEL WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_SHARED_RX  // AddRxSubscriber(), ~1.1 KB
+#define WAVESHARE_CAN_SHARED_RX WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_RULES  // AddRule(), ~1.1 KB
+#define WAVESHARE_CAN_RULES WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_RX_BATCHING  // SetRxBatching(), ~0.7 KB
+#define WAVESHARE_CAN_RX_BATCHING WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_FILTER_PROGRAM  // SetRxFilterProgram(), ~0.5 KB
+#define WAVESHARE_CAN_FILTER_PROGRAM WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_RX_PRIORITY  // AddRxPriorityRange(), ~0.4 KB
+#define WAVESHARE_CAN_RX_PRIORITY WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+#ifndef WAVESHARE_CAN_RTR_RESPONDER  // SetRtrResponse(), ~0.2 KB
+#define WAVESHARE_CAN_RTR_RESPONDER WAVESHARE_CAN_FEATURE_DEFAULT
+#endif
+
+#ifndef WAVESHARE_CAN_LOG_POLICY
+#define WAVESHARE_CAN_LOG_POLICY CanLogSerial
+#endif
+#ifndef WAVESHARE_CAN_STATS_POLICY
+#define WAVESHARE_CAN_STATS_POLICY CanStatsFull
+#endif
+
+using CanLog = WAVESHARE_CAN_LOG_POLICY;
+using CanStats = WAVESHARE_CAN_STATS_POLICY;
+
+#endif  // PROJECT_WAVESHARE_CAN_POLICIES_H_
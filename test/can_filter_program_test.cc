@@ -0,0 +1,210 @@
+// Copyright 2026 p43lz3r
+// Host test for CanFilterProgram: operator precedence, Validate() on
+// malformed bytecode and Matches() on sample frames. From the repo root:
+//
+//   g++ -std=c++17 -Itest/fake_idf -Isrc test/can_filter_program_test.cc
+//       src/can_filter_program.cc -o filter_program_test
+//   ./filter_program_test
+
+#include <stdio.h>
+#include <string>
+#include "can_filter_program.h"
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                  \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+twai_message_t Frame(uint32_t id, uint8_t dlc, bool extended = false,
+                     bool rtr = false) {
+  twai_message_t msg = {};
+  msg.identifier = id;
+  msg.data_length_code = dlc;
+  msg.extd = extended;
+  msg.rtr = rtr;
+  for (int i = 0; i < 8; i++) msg.data[i] = 0x10 * (i + 1);  // 10 20 .. 80
+  return msg;
+}
+
+bool Eval(const char* expression, const twai_message_t& msg) {
+  CanFilterProgram program;
+  bool compiled = program.Compile(expression);
+  if (!compiled) {
+    printf("  \"%s\": %s at %zu\n", expression, program.Error(),
+           program.ErrorPos());
+  }
+  EXPECT(compiled);
+  return compiled && program.Matches(msg);
+}
+
+// Each expression is also valid C++ over constants, so the compiler's
+// result must equal the one C++ precedence gives. Each case flips if
+// the two operators are grouped the other way.
+void TestPrecedence() {
+  struct Case {
+    const char* expression;
+    uint32_t expected;  // C++ value; the filter matches if non-zero
+  };
+  const Case cases[] = {
+      {"1 || 0 && 0", 1 || (0 && 0)},
+      {"0 && 0 || 1", (0 && 0) || 1},
+      {"0 || 2 & 1", 0 || (2 & 1)},
+      {"1 | 2 == 2", 1 | (2 == 2)},
+      {"5 & 3 == 3", 5 & (3 == 3)},  // C quirk kept: == binds tighter than &
+      {"1 ^ 1 | 1", (1 ^ 1) | 1},
+      {"0 & 1 ^ 1", (0 & 1) ^ 1},
+      {"1 | 0 ^ 1", 1 | (0 ^ 1)},
+      {"1 < 2 == 1", (1 < 2) == 1},
+      {"2 > 1 != 1", (2 > 1) != 1},
+      {"1 << 4 == 1", (1 << 4) == 1},
+      {"256 >> 4 >= 17", (256 >> 4) >= 17},
+      {"1 << 2 << 1 == 8", ((1 << 2) << 1) == 8},  // Left-associative
+      {"!2 == 2", (!2) == 2},
+      {"~1 >> 31 == 0", (~1u >> 31) == 0},
+      {"not 1 or 1", !1 || 1},
+      {"(1 || 0) && 0", (1 || 0) && 0},
+      {"2 in 1..3 == 1", 1},  // in binds tighter than ==
+      {"1 << 2 in 1..1", 0},  // << binds tighter than in
+  };
+  twai_message_t msg = Frame(0x100, 8);
+  for (const Case& c : cases) {
+    bool result = Eval(c.expression, msg);
+    bool expected = c.expected != 0;
+    if (result != expected) printf("  precedence: \"%s\"\n", c.expression);
+    EXPECT(result == expected);
+  }
+
+  // The loosest operator is emitted last
+  CanFilterProgram program;
+  EXPECT(program.Compile("id == 1 || dlc == 2 && ext"));
+  EXPECT(program.Code()[program.Size() - 1].op == kFilterOr);
+  EXPECT(program.Compile("(id == 1 || dlc == 2) && ext"));
+  EXPECT(program.Code()[program.Size() - 1].op == kFilterAnd);
+}
+
+void TestMatches() {
+  const char* j1939 = "id == 0x18FEF100 && ext && (data[2] & 0x10)";
+  EXPECT(Eval(j1939, Frame(0x18FEF100, 8, true)));
+  EXPECT(!Eval(j1939, Frame(0x18FEF100, 8, false)));
+  EXPECT(!Eval(j1939, Frame(0x18FEF101, 8, true)));
+  EXPECT(!Eval(j1939, Frame(0x18FEF100, 2, true)));  // data[2] past the DLC
+
+  const char* range = "DLC == 8 and data[0] in 0x10..0x1F";
+  EXPECT(Eval(range, Frame(0x7DF, 8)));
+  EXPECT(!Eval(range, Frame(0x7DF, 7)));
+  twai_message_t high = Frame(0x7DF, 8);
+  high.data[0] = 0x20;
+  EXPECT(!Eval(range, high));
+
+  // Little-endian 16-bit signal
+  const char* word = "(data[1] << 8 | data[0]) >= 1000";
+  twai_message_t msg = Frame(0x200, 2);
+  msg.data[0] = 0xE8;
+  msg.data[1] = 0x03;  // 1000
+  EXPECT(Eval(word, msg));
+  msg.data[0] = 0xE7;
+  EXPECT(!Eval(word, msg));
+
+  // Remote frames carry no data
+  EXPECT(Eval("rtr && data[0] == 0", Frame(0x300, 8, false, true)));
+  EXPECT(!Eval("rtr", Frame(0x300, 8)));
+
+  // Keywords are case-insensitive
+  EXPECT(Eval("ID == 0x300 AND NOT Ext", Frame(0x300, 0)));
+
+  // An empty program matches everything
+  CanFilterProgram empty;
+  EXPECT(empty.Matches(Frame(0x123, 0)));
+}
+
+void TestCompileErrors() {
+  const char* bad[] = {
+      "", "id ==", "data[8]", "data[1", "0x", "1 2", "id in 3",
+      "0x100000000", "foo", "(id == 1", "id == 1)",
+      "((((((((((((((((((((1))))))))))))))))))))",
+  };
+  CanFilterProgram program;
+  for (const char* expression : bad) {
+    bool compiled = program.Compile(expression);
+    if (compiled) printf("  accepted \"%s\"\n", expression);
+    EXPECT(!compiled);
+    EXPECT(program.Empty());
+    EXPECT(program.Error() != nullptr);
+  }
+
+  std::string too_long = "id";
+  for (int i = 0; i < 40; i++) too_long += " || id";
+  EXPECT(!program.Compile(too_long.c_str()));
+  EXPECT(program.Empty());
+}
+
+void TestValidate() {
+  const char* error = nullptr;
+
+  CanFilterInsn underflow[] = {{kFilterId, 0, 0}, {kFilterEq, 0, 0}};
+  EXPECT(!CanFilterProgram::Validate(underflow, 2, &error));
+  EXPECT(error != nullptr && std::string(error) == "stack underflow");
+
+  CanFilterInsn unary_on_empty[] = {{kFilterNot, 0, 0}};
+  EXPECT(!CanFilterProgram::Validate(unary_on_empty, 1));
+
+  CanFilterInsn range_short[] = {{kFilterId, 0, 0}, {kFilterConst, 0, 1},
+                                 {kFilterInRange, 0, 0}};
+  EXPECT(!CanFilterProgram::Validate(range_short, 3));
+
+  // kMaxStack + 1 pushes, folded back down so only the depth is wrong
+  CanFilterInsn overflow[CanFilterProgram::kMaxInsns];
+  size_t n = 0;
+  for (size_t i = 0; i <= CanFilterProgram::kMaxStack; i++) {
+    overflow[n++] = CanFilterInsn{kFilterId, 0, 0};
+  }
+  for (size_t i = 0; i < CanFilterProgram::kMaxStack; i++) {
+    overflow[n++] = CanFilterInsn{kFilterOr, 0, 0};
+  }
+  EXPECT(!CanFilterProgram::Validate(overflow, n, &error));
+  EXPECT(error != nullptr && std::string(error) == "expression too deep");
+  // One push fewer is fine
+  EXPECT(CanFilterProgram::Validate(overflow + 1, n - 2));
+
+  // No jumps exist; out-of-range opcodes and operands are the analogue
+  CanFilterInsn bad_op[] = {{kFilterOpCount, 0, 0}};
+  EXPECT(!CanFilterProgram::Validate(bad_op, 1, &error));
+  EXPECT(error != nullptr && std::string(error) == "unknown opcode");
+  CanFilterInsn bad_index[] = {{kFilterData, 8, 0}};
+  EXPECT(!CanFilterProgram::Validate(bad_index, 1, &error));
+  EXPECT(error != nullptr && std::string(error) == "data index out of range");
+
+  CanFilterInsn two_values[] = {{kFilterId, 0, 0}, {kFilterDlc, 0, 0}};
+  EXPECT(!CanFilterProgram::Validate(two_values, 2));
+  EXPECT(!CanFilterProgram::Validate(nullptr, 0));
+  EXPECT(!CanFilterProgram::Validate(overflow,
+                                     CanFilterProgram::kMaxInsns + 1));
+
+  // Load() validates too and leaves the program empty on failure
+  CanFilterProgram program;
+  EXPECT(!program.Load(underflow, 2));
+  EXPECT(program.Empty());
+  CanFilterInsn ok[] = {{kFilterId, 0, 0}, {kFilterConst, 0, 0x123},
+                        {kFilterEq, 0, 0}};
+  EXPECT(program.Load(ok, 3));
+  EXPECT(program.Matches(Frame(0x123, 0)));
+  EXPECT(!program.Matches(Frame(0x124, 0)));
+}
+
+}  // namespace
+
+int main() {
+  TestPrecedence();
+  TestMatches();
+  TestCompileErrors();
+  TestValidate();
+  if (failures == 0) printf("can_filter_program_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// Copyright 2026 p43lz3r
+// Host test for CanIdSet: random standard and extended sets of several
+// sizes, checked member by member and against non-members, plus the
+// generated acceptance filter. Needs the fake driver/twai.h types only:
+//
+//   g++ -std=c++17 -Itest/fake_idf -Isrc test/can_id_set_test.cc -o id_set_test
+//   ./id_set_test
+
+#include <stdio.h>
+#include <random>
+#include <set>
+#include "can_id_set.h"
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                  \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+// Built by the compiler: a failure here is a build error
+constexpr CanIdSet<4> kConstSet({0x100, 0x1A0, 0x2F1, 0x7DF});
+static_assert(kConstSet.Valid(), "constexpr set");
+static_assert(kConstSet.IndexOf(0x2F1) == 2, "member index");
+static_assert(!kConstSet.Contains(0x101), "non-member");
+static_assert(!kConstSet.Contains(CanIdLookup::kEmptyKey), "empty key");
+
+std::mt19937 rng(12345);
+
+// Acceptance filter check as the controller does it (mask 1 = don't care)
+bool FilterAccepts(const twai_filter_config_t& config, uint32_t id,
+                   bool extended) {
+  uint32_t care = ~config.acceptance_mask;
+  if (extended) {
+    return (((id << 3) ^ config.acceptance_code) & care & 0xFFFFFFF8) == 0;
+  }
+  if (config.single_filter) {
+    return (((id << 21) ^ config.acceptance_code) & care & 0xFFE00000) == 0;
+  }
+  bool first = (((id << 21) ^ config.acceptance_code) & care & 0xFFE00000) == 0;
+  bool second = (((id << 5) ^ config.acceptance_code) & care & 0x0000FFE0) == 0;
+  return first || second;
+}
+
+template <size_t N>
+void CheckRandomSet(bool extended) {
+  const uint32_t max_id = extended ? 0x1FFFFFFF : 0x7FF;
+  std::uniform_int_distribution<uint32_t> any_id(0, max_id);
+  std::set<uint32_t> members;
+  uint32_t ids[N];
+  for (size_t i = 0; i < N; i++) {
+    uint32_t id;
+    do {
+      id = any_id(rng);
+    } while (!members.insert(id).second);
+    ids[i] = id;
+  }
+
+  CanIdSet<N> set(ids, extended);
+  EXPECT(set.Valid());
+  if (!set.Valid()) return;
+
+  twai_filter_config_t filter = set.FilterConfig();
+  for (size_t i = 0; i < N; i++) {
+    EXPECT(set.IndexOf(ids[i]) == static_cast<int>(i));
+    EXPECT(FilterAccepts(filter, ids[i], extended));
+  }
+  EXPECT(set.View().Find(ids[0], extended) == 0);
+  EXPECT(set.View().Find(ids[0], !extended) == -1);  // Other ID format
+
+  for (int n = 0; n < 2000; n++) {
+    uint32_t id = any_id(rng);
+    if (members.count(id) == 0) EXPECT(!set.Contains(id));
+  }
+  EXPECT(!set.Contains(CanIdLookup::kEmptyKey));
+  EXPECT(!set.Contains(max_id + 1));
+
+  if (!extended) {
+    // Every standard ID the hardware lets through is counted
+    uint32_t passes = 0;
+    for (uint32_t id = 0; id <= 0x7FF; id++) {
+      if (FilterAccepts(filter, id, false)) passes++;
+    }
+    EXPECT(passes >= N && passes <= set.HardwarePassCount());
+  }
+}
+
+template <size_t N>
+void CheckSize(int sets) {
+  for (int i = 0; i < sets; i++) {
+    CheckRandomSet<N>(false);
+    CheckRandomSet<N>(true);
+  }
+}
+
+void TestRejectedSets() {
+  uint32_t duplicate[3] = {0x100, 0x200, 0x100};
+  CanIdSet<3> dup_set(duplicate);
+  EXPECT(!dup_set.Valid());
+  EXPECT(!dup_set.Contains(0x100));
+
+  uint32_t too_big[2] = {0x100, 0x800};  // 12 bits in a standard set
+  CanIdSet<2> big_set(too_big);
+  EXPECT(!big_set.Valid());
+  EXPECT(!big_set.Contains(0x100));
+
+  uint32_t extended[2] = {0x100, 0x800};
+  EXPECT(CanIdSet<2>(extended, true).Valid());
+}
+
+}  // namespace
+
+int main() {
+  CheckSize<1>(8);
+  CheckSize<2>(8);
+  CheckSize<7>(8);
+  CheckSize<12>(8);  // Largest size with exhaustive dual-filter search
+  CheckSize<13>(8);
+  CheckSize<64>(8);
+  CheckSize<255>(8);
+  TestRejectedSets();
+  if (failures == 0) printf("can_id_set_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}
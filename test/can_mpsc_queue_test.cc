@@ -0,0 +1,92 @@
+// Copyright 2026 p43lz3r
+// Host contention test for CanMpscQueue: several std::thread producers,
+// one consumer, a queue small enough to run full constantly. From the
+// repo root:
+//
+//   g++ -std=c++17 -O2 -Isrc test/can_mpsc_queue_test.cc -lpthread -o mpsc_test
+//   ./mpsc_test
+
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "can_mpsc_queue.h"
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                  \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+struct Item {
+  uint32_t producer;
+  uint32_t sequence;
+};
+
+void TestEmptyAndFull() {
+  CanMpscQueue<Item> queue;
+  EXPECT(queue.Init(3));
+  EXPECT(queue.Capacity() == 4);
+  Item item;
+  EXPECT(!queue.Pop(&item));
+  for (uint32_t i = 0; i < 4; i++) EXPECT(queue.Push(Item{0, i}));
+  EXPECT(!queue.Push(Item{0, 4}));
+  EXPECT(queue.Size() == 4);
+  EXPECT(queue.Pop(&item) && item.sequence == 0);
+  EXPECT(queue.Push(Item{0, 4}));
+  for (uint32_t i = 1; i <= 4; i++) EXPECT(queue.Pop(&item) && item.sequence == i);
+  EXPECT(!queue.Pop(&item));
+}
+
+void TestContention(size_t producers, size_t capacity, uint32_t per_producer) {
+  CanMpscQueue<Item> queue;
+  EXPECT(queue.Init(capacity));
+
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; p++) {
+    threads.emplace_back([&queue, p, per_producer] {
+      for (uint32_t i = 0; i < per_producer; i++) {
+        while (!queue.Push(Item{p, i})) std::this_thread::yield();
+      }
+    });
+  }
+
+  // Each producer's items must arrive exactly once and in order
+  std::vector<uint32_t> next(producers, 0);
+  uint64_t received = 0;
+  const uint64_t total = static_cast<uint64_t>(producers) * per_producer;
+  bool ok = true;
+  Item item;
+  while (received < total && ok) {
+    if (!queue.Pop(&item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ok = item.producer < producers && item.sequence == next[item.producer];
+    if (ok) next[item.producer]++;
+    received++;
+  }
+  for (std::thread& thread : threads) thread.join();
+
+  EXPECT(ok);
+  EXPECT(received == total);
+  for (size_t p = 0; p < producers; p++) EXPECT(next[p] == per_producer);
+  EXPECT(!queue.Pop(&item));  // Nothing duplicated or left behind
+  EXPECT(queue.Size() == 0);
+}
+
+}  // namespace
+
+int main() {
+  TestEmptyAndFull();
+  TestContention(2, 4, 200000);
+  TestContention(4, 16, 200000);
+  TestContention(8, 64, 100000);
+  if (failures == 0) printf("can_mpsc_queue_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+// Copyright 2026 p43lz3r
+// Host stand-in for the parts of the Arduino-ESP32 core the library uses.
+#ifndef TEST_FAKE_IDF_ARDUINO_H_
+#define TEST_FAKE_IDF_ARDUINO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 0x03
+
+// Library logging is swallowed so test output stays readable
+class HardwareSerial {
+ public:
+  int printf(const char*, ...) { return 0; }
+  size_t print(const char*) { return 0; }
+  size_t println(const char* = "") { return 0; }
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void disableCore0WDT();
+void disableCore1WDT();
+void enableCore0WDT();
+void enableCore1WDT();
+
+#endif  // TEST_FAKE_IDF_ARDUINO_H_
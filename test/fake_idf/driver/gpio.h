@@ -0,0 +1,15 @@
+// Copyright 2026 p43lz3r
+#ifndef TEST_FAKE_IDF_DRIVER_GPIO_H_
+#define TEST_FAKE_IDF_DRIVER_GPIO_H_
+
+#include <stdint.h>
+#include "driver/twai.h"
+
+typedef enum { GPIO_MODE_INPUT = 1, GPIO_MODE_OUTPUT = 2 } gpio_mode_t;
+#define GPIO_IS_VALID_GPIO(n) ((n) >= 0 && (n) < 49)
+#define GPIO_IS_VALID_OUTPUT_GPIO(n) ((n) >= 0 && (n) < 49)
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode);
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level);
+
+#endif  // TEST_FAKE_IDF_DRIVER_GPIO_H_
@@ -0,0 +1,8 @@
+// Copyright 2026 p43lz3r
+#ifndef TEST_FAKE_IDF_ESP_ATTR_H_
+#define TEST_FAKE_IDF_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif  // TEST_FAKE_IDF_ESP_ATTR_H_
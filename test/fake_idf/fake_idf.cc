@@ -0,0 +1,322 @@
+// Copyright 2026 p43lz3r
+// Host implementation of the ESP-IDF/FreeRTOS/Arduino subset declared in
+// this directory. Tasks are detached std::threads and every critical
+// section takes one recursive mutex - enough to run WaveshareCan's tasks
+// against the fake controller, not a scheduler model.
+#include "fake_idf.h"
+
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+
+struct tskTaskControlBlock {
+  std::mutex lock;
+  std::condition_variable wake;
+  uint32_t notifications = 0;
+  uint32_t run_time = 0;
+  std::string name;
+};
+
+namespace {
+
+std::recursive_mutex critical_lock;
+std::atomic<int64_t> time_offset_us(0);
+const std::chrono::steady_clock::time_point boot =
+    std::chrono::steady_clock::now();
+
+tskTaskControlBlock main_task;
+thread_local tskTaskControlBlock* current_task = &main_task;
+std::mutex tasks_lock;
+std::vector<tskTaskControlBlock*> tasks;  // In creation order
+
+struct FakeController {
+  std::mutex lock;
+  std::condition_variable rx_ready;
+  std::deque<twai_message_t> rx;
+  std::deque<twai_message_t> transmitted;
+  esp_err_t transmit_result = ESP_OK;
+  uint32_t tx_backlog = 0;
+  uint32_t clear_calls = 0;
+  bool running = false;
+} controller;
+
+void SleepTicks(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+}  // namespace
+
+namespace fake_idf {
+
+void Reset() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.rx.clear();
+  controller.transmitted.clear();
+  controller.transmit_result = ESP_OK;
+  controller.tx_backlog = 0;
+  controller.clear_calls = 0;
+}
+
+void InjectRx(const twai_message_t& message) {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.rx.push_back(message);
+  controller.rx_ready.notify_all();
+}
+
+void SetTransmitResult(esp_err_t result) {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.transmit_result = result;
+}
+
+size_t TransmittedCount() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  return controller.transmitted.size();
+}
+
+bool TakeTransmitted(twai_message_t* message) {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  if (controller.transmitted.empty()) return false;
+  *message = controller.transmitted.front();
+  controller.transmitted.pop_front();
+  return true;
+}
+
+void SetTxBacklog(uint32_t frames) {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.tx_backlog = frames;
+}
+
+uint32_t ClearTransmitCalls() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  return controller.clear_calls;
+}
+
+void AdvanceTime(int64_t us) { time_offset_us += us; }
+
+TaskHandle_t FindTask(const char* name) {
+  std::lock_guard<std::mutex> guard(tasks_lock);
+  for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+    if ((*it)->name == name) return *it;
+  }
+  return nullptr;
+}
+
+void SetRunTimeCounter(TaskHandle_t task, uint32_t counter) {
+  std::lock_guard<std::mutex> guard(task->lock);
+  task->run_time = counter;
+}
+
+}  // namespace fake_idf
+
+// FreeRTOS
+void portENTER_CRITICAL(portMUX_TYPE*) { critical_lock.lock(); }
+void portEXIT_CRITICAL(portMUX_TYPE*) { critical_lock.unlock(); }
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name,
+                       uint32_t stack_words, void* arg, UBaseType_t priority,
+                       TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(function, name, stack_words, arg, priority,
+                                 handle, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name,
+                                   uint32_t, void* arg, UBaseType_t,
+                                   TaskHandle_t* handle, BaseType_t) {
+  TaskHandle_t task = new tskTaskControlBlock();  // Never freed
+  task->name = name;
+  {
+    std::lock_guard<std::mutex> guard(tasks_lock);
+    tasks.push_back(task);
+  }
+  if (handle) *handle = task;
+  std::thread([function, arg, task] {
+    current_task = task;
+    function(arg);
+  }).detach();
+  return pdPASS;
+}
+
+// Tasks only delete themselves, right before returning
+void vTaskDelete(TaskHandle_t) {}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) {
+    std::this_thread::yield();
+  } else {
+    SleepTicks(ticks);
+  }
+}
+
+void taskYIELD() { std::this_thread::yield(); }
+
+TickType_t xTaskGetTickCount() {
+  return static_cast<TickType_t>(esp_timer_get_time() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return current_task; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 1024; }
+
+void vTaskGetInfo(TaskHandle_t handle, TaskStatus_t* status, BaseType_t,
+                  eTaskState) {
+  *status = TaskStatus_t();
+  status->xHandle = handle;
+  std::lock_guard<std::mutex> guard(handle->lock);
+  status->ulRunTimeCounter = handle->run_time;
+}
+
+configRUN_TIME_COUNTER_TYPE ulTaskGetIdleRunTimeCounter() { return 0; }
+
+uint32_t portGET_RUN_TIME_COUNTER_VALUE() {
+  return static_cast<uint32_t>(esp_timer_get_time());
+}
+
+BaseType_t xPortGetCoreID() { return 0; }
+
+void xTaskNotifyGive(TaskHandle_t handle) {
+  std::lock_guard<std::mutex> guard(handle->lock);
+  handle->notifications++;
+  handle->wake.notify_all();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t*) {
+  xTaskNotifyGive(handle);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  tskTaskControlBlock* task = current_task;
+  std::unique_lock<std::mutex> guard(task->lock);
+  task->wake.wait_for(guard, std::chrono::milliseconds(ticks),
+                      [task] { return task->notifications > 0; });
+  uint32_t value = task->notifications;
+  if (value > 0) task->notifications = clear ? 0 : value - 1;
+  return value;
+}
+
+// Semaphores are only needed by the register backend, which the host
+// build leaves out (WAVESHARE_CAN_LOW_LEVEL=0).
+SemaphoreHandle_t xSemaphoreCreateBinary() { return nullptr; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdFALSE; }
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t, BaseType_t*) {
+  return pdFALSE;
+}
+void vSemaphoreDelete(SemaphoreHandle_t) {}
+
+// esp_timer
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - boot)
+             .count() +
+         time_offset_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t*,
+                           esp_timer_handle_t* handle) {
+  static int dummy;
+  *handle = reinterpret_cast<esp_timer_handle_t>(&dummy);
+  return ESP_OK;
+}
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t, uint64_t) {
+  return ESP_OK;
+}
+esp_err_t esp_timer_stop(esp_timer_handle_t) { return ESP_OK; }
+esp_err_t esp_timer_delete(esp_timer_handle_t) { return ESP_OK; }
+
+// TWAI driver
+esp_err_t twai_driver_install(const twai_general_config_t*,
+                              const twai_timing_config_t*,
+                              const twai_filter_config_t*) {
+  return ESP_OK;
+}
+esp_err_t twai_driver_uninstall() { return ESP_OK; }
+
+esp_err_t twai_start() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.running = true;
+  return ESP_OK;
+}
+
+esp_err_t twai_stop() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.running = false;
+  return ESP_OK;
+}
+
+esp_err_t twai_transmit(const twai_message_t* message, TickType_t) {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  if (controller.transmit_result == ESP_OK) {
+    controller.transmitted.push_back(*message);
+  }
+  return controller.transmit_result;
+}
+
+esp_err_t twai_receive(twai_message_t* message, TickType_t ticks) {
+  std::unique_lock<std::mutex> guard(controller.lock);
+  if (!controller.rx_ready.wait_for(guard, std::chrono::milliseconds(ticks),
+                                    [] { return !controller.rx.empty(); })) {
+    return ESP_ERR_TIMEOUT;
+  }
+  *message = controller.rx.front();
+  controller.rx.pop_front();
+  return ESP_OK;
+}
+
+esp_err_t twai_read_alerts(uint32_t*, TickType_t ticks) {
+  SleepTicks(ticks < 10 ? ticks : 10);
+  return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t twai_reconfigure_alerts(uint32_t, uint32_t* previous) {
+  if (previous) *previous = 0;
+  return ESP_OK;
+}
+
+esp_err_t twai_initiate_recovery() { return ESP_OK; }
+
+esp_err_t twai_get_status_info(twai_status_info_t* status) {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  *status = twai_status_info_t();
+  status->state = controller.running ? TWAI_STATE_RUNNING : TWAI_STATE_STOPPED;
+  status->msgs_to_tx = controller.tx_backlog;
+  status->msgs_to_rx = controller.rx.size();
+  return ESP_OK;
+}
+
+esp_err_t twai_clear_transmit_queue() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.clear_calls++;
+  controller.tx_backlog = 0;
+  return ESP_OK;
+}
+
+esp_err_t twai_clear_receive_queue() {
+  std::lock_guard<std::mutex> guard(controller.lock);
+  controller.rx.clear();
+  return ESP_OK;
+}
+
+// GPIO
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t) { return ESP_OK; }
+esp_err_t gpio_set_level(gpio_num_t, uint32_t) { return ESP_OK; }
+
+// Arduino
+HardwareSerial Serial;
+
+unsigned long millis() { return static_cast<unsigned long>(esp_timer_get_time() / 1000); }
+unsigned long micros() { return static_cast<unsigned long>(esp_timer_get_time()); }
+void delay(unsigned long ms) { SleepTicks(ms); }
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+void disableCore0WDT() {}
+void disableCore1WDT() {}
+void enableCore0WDT() {}
+void enableCore1WDT() {}
@@ -0,0 +1,40 @@
+// Copyright 2026 p43lz3r
+// Test controls for the host ESP-IDF stand-in. The fake TWAI controller
+// keeps an RX FIFO the test fills, records every transmitted frame and
+// returns a scripted result from twai_transmit().
+#ifndef TEST_FAKE_IDF_FAKE_IDF_H_
+#define TEST_FAKE_IDF_FAKE_IDF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+#include "freertos/task.h"
+
+namespace fake_idf {
+
+// Back to an empty, successful controller
+void Reset();
+
+void InjectRx(const twai_message_t& message);
+
+// Result of the next twai_transmit() calls; failed frames are not recorded
+void SetTransmitResult(esp_err_t result);
+size_t TransmittedCount();
+bool TakeTransmitted(twai_message_t* message);
+
+// Frames the driver reports as still waiting (status.msgs_to_tx)
+void SetTxBacklog(uint32_t frames);
+uint32_t ClearTransmitCalls();
+
+// Shifts esp_timer_get_time() and xTaskGetTickCount() forward
+void AdvanceTime(int64_t us);
+
+// Most recently created task with this name, or nullptr
+TaskHandle_t FindTask(const char* name);
+
+// Value vTaskGetInfo() reports as ulRunTimeCounter for a task
+void SetRunTimeCounter(TaskHandle_t task, uint32_t counter);
+
+}  // namespace fake_idf
+
+#endif  // TEST_FAKE_IDF_FAKE_IDF_H_
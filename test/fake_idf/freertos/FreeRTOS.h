@@ -0,0 +1,35 @@
+// Copyright 2026 p43lz3r
+// Host stand-in for the FreeRTOS types the library uses (see fake_idf.cc).
+#ifndef TEST_FAKE_IDF_FREERTOS_FREERTOS_H_
+#define TEST_FAKE_IDF_FREERTOS_FREERTOS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;  // 1 tick = 1 ms
+typedef uint32_t StackType_t;
+typedef uint32_t configRUN_TIME_COUNTER_TYPE;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configGENERATE_RUN_TIME_STATS 1
+
+// All critical sections share one recursive host mutex
+typedef struct {
+  int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void portENTER_CRITICAL(portMUX_TYPE* mux);
+void portEXIT_CRITICAL(portMUX_TYPE* mux);
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+#endif  // TEST_FAKE_IDF_FREERTOS_FREERTOS_H_
@@ -0,0 +1,9 @@
+// Copyright 2026 p43lz3r
+#ifndef TEST_FAKE_IDF_FREERTOS_QUEUE_H_
+#define TEST_FAKE_IDF_FREERTOS_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct QueueDefinition* QueueHandle_t;
+
+#endif  // TEST_FAKE_IDF_FREERTOS_QUEUE_H_
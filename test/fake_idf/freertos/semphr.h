@@ -0,0 +1,13 @@
+// Copyright 2026 p43lz3r
+#ifndef TEST_FAKE_IDF_FREERTOS_SEMPHR_H_
+#define TEST_FAKE_IDF_FREERTOS_SEMPHR_H_
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* woken);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif  // TEST_FAKE_IDF_FREERTOS_SEMPHR_H_
@@ -0,0 +1,48 @@
+// Copyright 2026 p43lz3r
+// Tasks run as detached std::threads; notifications are per-task counters.
+#ifndef TEST_FAKE_IDF_FREERTOS_TASK_H_
+#define TEST_FAKE_IDF_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+
+typedef struct {
+  TaskHandle_t xHandle;
+  const char* pcTaskName;
+  UBaseType_t xTaskNumber;
+  eTaskState eCurrentState;
+  UBaseType_t uxCurrentPriority;
+  UBaseType_t uxBasePriority;
+  configRUN_TIME_COUNTER_TYPE ulRunTimeCounter;
+  StackType_t* pxStackBase;
+  uint32_t usStackHighWaterMark;
+  BaseType_t xCoreID;
+} TaskStatus_t;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name,
+                       uint32_t stack_words, void* arg, UBaseType_t priority,
+                       TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name,
+                                   uint32_t stack_words, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t handle);  // Only vTaskDelete(NULL) is supported
+void vTaskDelay(TickType_t ticks);
+void taskYIELD();
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle);
+void vTaskGetInfo(TaskHandle_t handle, TaskStatus_t* status,
+                  BaseType_t get_high_water, eTaskState state);
+configRUN_TIME_COUNTER_TYPE ulTaskGetIdleRunTimeCounter();
+uint32_t portGET_RUN_TIME_COUNTER_VALUE();
+BaseType_t xPortGetCoreID();
+void xTaskNotifyGive(TaskHandle_t handle);
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t* woken);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+
+#endif  // TEST_FAKE_IDF_FREERTOS_TASK_H_
@@ -0,0 +1,2 @@
+// Copyright 2026 p43lz3r
+// Empty: the library's defaults cover every CONFIG_ option it reads.
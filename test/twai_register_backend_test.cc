@@ -0,0 +1,213 @@
+// Copyright 2026 p43lz3r
+// Host test for the register-level backend running against
+// TwaiRegisterModel. Needs no ESP-IDF headers; from the repo root:
+//
+//   g++ -std=c++17 -Isrc test/twai_register_backend_test.cc -o twai_test
+//   ./twai_test
+
+#include <stdio.h>
+#include "twai_register_backend.h"
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                  \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+typedef TwaiRegisterBackend<TwaiRegisterModel, 8> Backend;
+
+twai_message_t Frame(uint32_t id, bool extended, uint8_t dlc) {
+  twai_message_t msg = {};
+  msg.identifier = id;
+  msg.extd = extended;
+  msg.data_length_code = dlc;
+  for (uint8_t i = 0; i < dlc; i++) msg.data[i] = 0x10 + i;
+  return msg;
+}
+
+void StartBackend(Backend* backend) {
+  twai_timing_config_t timing = {};
+  timing.brp = 8;  // 500 kbit/s
+  timing.tseg_1 = 15;
+  timing.tseg_2 = 4;
+  timing.sjw = 3;
+  twai_filter_config_t filter = {0, 0xFFFFFFFF, true};
+  backend->Configure(timing, filter, false);
+  backend->Start();
+}
+
+bool OddIdsOnly(const twai_message_t& msg, void*) { return msg.identifier & 1; }
+
+void TestConfigure() {
+  Backend backend;
+  StartBackend(&backend);
+  TwaiRegisterModel& io = backend.io();
+  EXPECT(io.Read(twai_reg::kBusTiming0) ==
+         ((2u << twai_reg::kBtr0SjwShift) | 3u));
+  EXPECT(io.Read(twai_reg::kBusTiming1) == (14u | (3u << 4)));
+  EXPECT((io.Read(twai_reg::kMode) & twai_reg::kModeReset) == 0);
+
+  twai_status_info_t status;
+  backend.GetStatus(&status);
+  EXPECT(status.state == TWAI_STATE_RUNNING);
+  backend.Stop();
+  backend.GetStatus(&status);
+  EXPECT(status.state == TWAI_STATE_STOPPED);
+}
+
+void TestReceive() {
+  Backend backend;
+  StartBackend(&backend);
+  TwaiRegisterModel& io = backend.io();
+
+  twai_message_t standard = Frame(0x123, false, 3);
+  twai_message_t extended = Frame(0x1ABCDEF1, true, 8);
+  EXPECT(io.InjectRxFrame(standard));
+  EXPECT(io.InjectRxFrame(extended));
+  EXPECT(io.IrqPending());
+  EXPECT(backend.ServiceInterrupt() & kTwaiEventRx);
+  EXPECT(!io.IrqPending());
+  EXPECT(backend.Pending() == 2);
+
+  twai_message_t msg;
+  EXPECT(backend.Receive(&msg));
+  EXPECT(msg.identifier == 0x123 && !msg.extd && msg.data_length_code == 3);
+  EXPECT(msg.data[2] == 0x12);
+  EXPECT(backend.Receive(&msg));
+  EXPECT(msg.identifier == 0x1ABCDEF1 && msg.extd && msg.data[7] == 0x17);
+  EXPECT(!backend.Receive(&msg));
+
+  backend.SetIsrFilter(OddIdsOnly, nullptr);
+  io.InjectRxFrame(Frame(0x122, false, 1));
+  io.InjectRxFrame(Frame(0x125, false, 1));
+  backend.ServiceInterrupt();
+  EXPECT(backend.Pending() == 1);
+  EXPECT(backend.GetFilteredCount() == 1);
+}
+
+void TestTransmit() {
+  Backend backend;
+  StartBackend(&backend);
+  TwaiRegisterModel& io = backend.io();
+  io.HoldTx(true);
+
+  twai_message_t msg = Frame(0x18FF1234, true, 8);
+  EXPECT(backend.Transmit(msg));
+  EXPECT(!backend.TxReady());
+  EXPECT(!backend.Transmit(Frame(0x100, false, 0)));  // Buffer still busy
+  EXPECT((backend.ServiceInterrupt() & kTwaiEventTxDone) == 0);
+
+  EXPECT(io.CompleteTx());
+  EXPECT(backend.ServiceInterrupt() & kTwaiEventTxDone);
+  EXPECT(backend.TxReady());
+
+  twai_message_t sent;
+  EXPECT(io.TakeTxFrame(&sent));
+  EXPECT(sent.identifier == 0x18FF1234 && sent.extd);
+  EXPECT(sent.data_length_code == 8 && sent.data[7] == 0x17);
+}
+
+void TestAbortTx() {
+  Backend backend;
+  StartBackend(&backend);
+  TwaiRegisterModel& io = backend.io();
+  EXPECT(backend.AbortTx() == 0);  // Nothing waiting
+
+  io.HoldTx(true);
+  EXPECT(backend.Transmit(Frame(0x300, false, 4)));
+  EXPECT(!backend.LastTxSucceeded());
+  EXPECT(backend.AbortTx() == 1);
+  EXPECT(backend.ServiceInterrupt() & kTwaiEventTxDone);
+  EXPECT(backend.TxReady());
+  EXPECT(!backend.LastTxSucceeded());
+  twai_message_t sent;
+  EXPECT(!io.TakeTxFrame(&sent));  // Never went out
+
+  io.HoldTx(false);
+  EXPECT(backend.Transmit(Frame(0x301, false, 1)));
+  EXPECT(backend.ServiceInterrupt() & kTwaiEventTxDone);
+  EXPECT(backend.LastTxSucceeded());
+  EXPECT(io.TakeTxFrame(&sent) && sent.identifier == 0x301);
+}
+
+void TestErrorStates() {
+  Backend backend;
+  StartBackend(&backend);
+  TwaiRegisterModel& io = backend.io();
+
+  io.SetErrorCounters(100, 0);  // Above the warning limit
+  EXPECT(backend.ServiceInterrupt() & kTwaiEventErrorState);
+  EXPECT(backend.GetErrorPassiveCount() == 0);
+
+  io.SetErrorCounters(130, 0);  // Error passive
+  EXPECT(backend.ServiceInterrupt() & kTwaiEventErrorState);
+  EXPECT(backend.GetErrorPassiveCount() == 1);
+
+  io.SetErrorCounters(10, 0);  // Back to error active
+  backend.ServiceInterrupt();
+  EXPECT(backend.GetErrorPassiveCount() == 1);
+
+  twai_status_info_t status;
+  backend.GetStatus(&status);
+  EXPECT(status.state == TWAI_STATE_RUNNING && status.tx_error_counter == 10);
+}
+
+void TestBusOffRecovery() {
+  Backend backend;
+  StartBackend(&backend);
+  TwaiRegisterModel& io = backend.io();
+  io.HoldTx(true);
+  EXPECT(backend.Transmit(Frame(0x200, false, 2)));
+
+  io.EnterBusOff();
+  uint32_t events = backend.ServiceInterrupt();
+  EXPECT(events & kTwaiEventBusOff);
+  EXPECT(events & kTwaiEventTxDone);  // Pending frame was aborted
+  EXPECT(backend.GetBusOffCount() == 1);
+  EXPECT(!backend.LastTxSucceeded());
+
+  twai_status_info_t status;
+  backend.GetStatus(&status);
+  EXPECT(status.state == TWAI_STATE_BUS_OFF);
+  EXPECT(!backend.TxReady());
+  EXPECT(!backend.Transmit(Frame(0x201, false, 1)));
+  EXPECT(io.Read(twai_reg::kAcceptanceMask) == 0xFF);  // Filter untouched
+
+  EXPECT(backend.StartRecovery());
+  backend.GetStatus(&status);
+  EXPECT(status.state == TWAI_STATE_RECOVERING);
+  EXPECT(!backend.Transmit(Frame(0x201, false, 1)));
+
+  EXPECT(io.FinishRecovery());
+  events = backend.ServiceInterrupt();
+  EXPECT(events & kTwaiEventTxDone);
+  EXPECT((events & kTwaiEventBusOff) == 0);
+  backend.GetStatus(&status);
+  EXPECT(status.state == TWAI_STATE_RUNNING && status.tx_error_counter == 0);
+  EXPECT(!backend.StartRecovery());  // Nothing to recover from
+
+  io.HoldTx(false);
+  EXPECT(backend.Transmit(Frame(0x202, false, 1)));
+  twai_message_t sent;
+  EXPECT(io.TakeTxFrame(&sent) && sent.identifier == 0x202);
+  EXPECT(!io.TakeTxFrame(&sent));  // The aborted frame never went out
+}
+
+}  // namespace
+
+int main() {
+  TestConfigure();
+  TestReceive();
+  TestTransmit();
+  TestAbortTx();
+  TestErrorStates();
+  TestBusOffRecovery();
+  if (failures == 0) printf("twai_register_backend_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}
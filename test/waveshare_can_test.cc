@@ -0,0 +1,224 @@
+// Copyright 2026 p43lz3r
+// Host test for WaveshareCan running on the fake ESP-IDF in test/fake_idf
+// (tasks are std::threads, the TWAI driver is scripted). From the repo root:
+//
+//   g++ -std=c++17 -DWAVESHARE_CAN_LOW_LEVEL=0 -Itest/fake_idf -Isrc
+//       test/waveshare_can_test.cc test/fake_idf/fake_idf.cc
+//       src/waveshare_can.cc src/can_filter_program.cc src/can_rules.cc
+//       -lpthread -o waveshare_can_test
+//   ./waveshare_can_test
+
+#include <stdio.h>
+#include "fake_idf.h"
+#include "waveshare_can.h"
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT(cond)                                                  \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: EXPECT(%s) failed\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+twai_message_t Frame(uint32_t id, bool extended, uint8_t dlc) {
+  twai_message_t msg = {};
+  msg.identifier = id;
+  msg.extd = extended;
+  msg.data_length_code = dlc;
+  for (uint8_t i = 0; i < dlc; i++) msg.data[i] = 0x10 + i;
+  return msg;
+}
+
+// Polls until cond() holds or timeout_ms passes
+template <typename Cond>
+bool WaitFor(Cond cond, uint32_t timeout_ms = 1000) {
+  for (uint32_t waited = 0; waited < timeout_ms; waited++) {
+    if (cond()) return true;
+    delay(1);
+  }
+  return cond();
+}
+
+void TestIdLimitDoesNotStallQueue() {
+  fake_idf::Reset();
+  WaveshareCan can;
+  EXPECT(can.Begin());
+  EXPECT(can.EnableTxQueue());
+  can.SetRateLimitAction(kRateLimitQueue);
+  EXPECT(can.SetIdRateLimit(0x100, false, 5));  // One frame per 200 ms
+
+  uint8_t data[1] = {0};
+  for (uint8_t i = 0; i < 3; i++) {
+    data[0] = i;
+    EXPECT(can.SendMessage(0x100, false, data, 1));
+    EXPECT(can.SendMessage(0x200, false, data, 1));
+  }
+
+  // 0x200 is unlimited and must not wait behind the throttled 0x100 frames
+  EXPECT(WaitFor([] { return fake_idf::TransmittedCount() == 4; }, 100));
+  twai_message_t sent[6];
+  size_t count = 0;
+  while (count < 4 && fake_idf::TakeTransmitted(&sent[count])) count++;
+  EXPECT(count == 4);
+  EXPECT(sent[0].identifier == 0x100 && sent[0].data[0] == 0);
+  size_t others = 0;
+  for (size_t i = 1; i < count; i++) {
+    if (sent[i].identifier == 0x200) EXPECT(sent[i].data[0] == others++);
+  }
+  EXPECT(others == 3);
+
+  // The parked 0x100 frames follow at the limited rate, in order
+  EXPECT(WaitFor([] { return fake_idf::TransmittedCount() == 2; }, 1000));
+  EXPECT(fake_idf::TakeTransmitted(&sent[4]) && sent[4].data[0] == 1);
+  EXPECT(fake_idf::TakeTransmitted(&sent[5]) && sent[5].data[0] == 2);
+  EXPECT(can.GetThrottledCount() == 2);
+  can.End();
+}
+
+void TestLateDriverFramesFlushed() {
+  fake_idf::Reset();
+  WaveshareCan can;
+  EXPECT(can.Begin());
+
+  CanFrame frame = {};
+  frame.id = 0x10;
+  frame.length = 1;
+  frame.deadline_us = 5000;
+  EXPECT(can.SendFrame(frame));
+  fake_idf::SetTxBacklog(1);  // Still waiting in the driver queue
+  fake_idf::AdvanceTime(10000);
+
+  // The next hand-off flushes the expired frame first, then queues its own
+  uint8_t data[1] = {0};
+  EXPECT(can.SendMessage(0x20, false, data, 1));
+  EXPECT(fake_idf::ClearTransmitCalls() == 1);
+  EXPECT(can.GetTxLateCount() == 1);
+
+  // A frame without deadline in the driver queue is never flushed
+  fake_idf::SetTxBacklog(2);
+  EXPECT(can.SendFrame(frame));
+  fake_idf::AdvanceTime(10000);
+  EXPECT(can.SendFrame(frame));
+  EXPECT(fake_idf::ClearTransmitCalls() == 1);
+  EXPECT(can.GetTxLateCount() == 1);
+
+  // Once the driver drains, deadline tracking starts over
+  fake_idf::SetTxBacklog(0);
+  EXPECT(can.SendFrame(frame));
+  fake_idf::SetTxBacklog(1);
+  fake_idf::AdvanceTime(10000);
+  EXPECT(can.SendFrame(frame));
+  EXPECT(fake_idf::ClearTransmitCalls() == 2);
+  EXPECT(can.GetTxLateCount() == 2);
+  EXPECT(fake_idf::TransmittedCount() == 6);
+  can.End();
+}
+
+#if WAVESHARE_CAN_RTR_RESPONDER
+void TestRtrAnswer() {
+  fake_idf::Reset();
+  WaveshareCan can;
+  EXPECT(can.Begin());
+  const uint8_t payload[2] = {0x12, 0x34};
+  EXPECT(can.SetRtrResponse(0x321, false, payload, 2));
+  EXPECT(can.EnableRxInterrupt());
+
+  twai_message_t request = Frame(0x321, false, 2);
+  request.rtr = true;
+  fake_idf::InjectRx(request);
+  EXPECT(WaitFor([&] { return can.GetRtrAnsweredCount() == 1; }));
+
+  twai_message_t reply;
+  EXPECT(fake_idf::TakeTransmitted(&reply));
+  EXPECT(reply.identifier == 0x321 && !reply.rtr);
+  EXPECT(reply.data_length_code == 2 && reply.data[1] == 0x34);
+  EXPECT(can.GetTxFailedCount() == 0);
+  can.End();
+}
+
+void TestRtrAnswerFailureCountedOnce() {
+  fake_idf::Reset();
+  WaveshareCan can;
+  EXPECT(can.Begin());
+  const uint8_t payload[1] = {0x55};
+  EXPECT(can.SetRtrResponse(0x321, false, payload, 1));
+  EXPECT(can.EnableRxInterrupt());
+
+  fake_idf::SetTransmitResult(ESP_FAIL);
+  twai_message_t request = Frame(0x321, false, 1);
+  request.rtr = true;
+  fake_idf::InjectRx(request);
+  EXPECT(WaitFor([&] { return can.GetRtrFailedCount() == 1; }));
+  EXPECT(can.GetRtrAnsweredCount() == 0);
+  EXPECT(can.GetTxFailedCount() == 1);  // One failed reply, one failure
+  EXPECT(can.GetTxExpiredCount() == 0);
+  can.End();
+}
+#endif  // WAVESHARE_CAN_RTR_RESPONDER
+
+// The FreeRTOS run-time counter is 32 bits of microseconds and wraps after
+// ~71 minutes; CPU time and share must carry on across the wrap
+void TestTaskCpuTimeAcrossCounterWrap() {
+  fake_idf::Reset();
+  WaveshareCan can;
+  EXPECT(can.Begin());
+  EXPECT(can.EnableRxInterrupt());
+  TaskHandle_t rx_task = fake_idf::FindTask("can_rx_task");
+  EXPECT(rx_task != nullptr);
+  if (rx_task == nullptr) return;
+
+  fake_idf::SetRunTimeCounter(rx_task, 0xFFFF0000);
+  EXPECT(can.GetTaskStats().rx.cpu_time_us == 0xFFFF0000ULL);
+
+  // 2^33 us later the task has run for 2^32 + 2^16 us: half of one core
+  fake_idf::AdvanceTime(1LL << 33);
+  fake_idf::SetRunTimeCounter(rx_task, 0x00010000);
+  WaveshareCan::TaskHealth rx = can.GetTaskStats().rx;
+  EXPECT(rx.cpu_time_us == 0x100010000ULL);
+  EXPECT(rx.cpu_percent == 50);
+  can.End();
+}
+
+#if WAVESHARE_CAN_RULES
+// != a value between raw steps holds for every raw value, but the rule
+// still needs a data frame that carries the signal
+void TestSignalRuleNeBetweenSteps() {
+  const CanSignal signal = {8, 8, false, 0.5f, 0.0f};  // data[1], 0.5 steps
+  CanRule ne = CanRule::OnSignal(0x400, false, signal, kRuleNe, 10.25f);
+  EXPECT(ne.Matches(Frame(0x400, false, 2)));
+  EXPECT(!ne.Matches(Frame(0x400, false, 1)));  // Too short for data[1]
+  twai_message_t remote = Frame(0x400, false, 8);
+  remote.rtr = true;
+  EXPECT(!ne.Matches(remote));
+  EXPECT(!ne.Matches(Frame(0x401, false, 2)));
+
+  CanRule eq = CanRule::OnSignal(0x400, false, signal, kRuleEq, 10.25f);
+  EXPECT(!eq.Matches(Frame(0x400, false, 2)));
+
+  // On a step the compare is a plain raw != (data[1] is 0x11 = 8.5)
+  CanRule ne_step = CanRule::OnSignal(0x400, false, signal, kRuleNe, 8.5f);
+  EXPECT(!ne_step.Matches(Frame(0x400, false, 2)));
+  EXPECT(!ne_step.Matches(Frame(0x400, false, 1)));
+}
+#endif
+
+}  // namespace
+
+int main() {
+  TestIdLimitDoesNotStallQueue();
+  TestLateDriverFramesFlushed();
+#if WAVESHARE_CAN_RTR_RESPONDER
+  TestRtrAnswer();
+  TestRtrAnswerFailureCountedOnce();
+#endif
+  TestTaskCpuTimeAcrossCounterWrap();
+#if WAVESHARE_CAN_RULES
+  TestSignalRuleNeBetweenSteps();
+#endif
+  if (failures == 0) printf("waveshare_can_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}